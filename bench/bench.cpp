@@ -0,0 +1,389 @@
+// Benchmark runner for a2.
+//
+// Renders the data/ scenes at fixed sizes and settings, each after a few
+// warmup runs and over a number of timed repetitions, and writes the
+// median wall time, the ray throughput of the render phase and the peak
+// memory of every scene as JSON. Given a baseline written by an earlier
+// run, it flags the scenes that got slower or bigger by more than a
+// threshold and exits with status 1.
+//
+// Every run is a separate a2 process started with -stats -no_cache, so the
+// timings include parsing, mesh loading and the accel build, and no state
+// carries over between repetitions.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace {
+
+struct Scene {
+    const char *name;
+    const char *file;  // 相对数据目录
+    int width;
+    int height;
+    const char *args;  // 其余的 a2 参数
+};
+
+// 与 sample_out/generate_images.sh 的设置一致, 另加一个抖动+滤波的场景
+// (每像素采样多, 图片取小); scene06_bunny_100w 的模型不在仓库中, 不参与测试
+const Scene kScenes[] = {
+    {"01_plane", "scene01_plane.txt", 800, 800, ""},
+    {"02_cube", "scene02_cube.txt", 800, 800, ""},
+    {"03_sphere", "scene03_sphere.txt", 800, 800, ""},
+    {"04_axes", "scene04_axes.txt", 800, 800, ""},
+    {"05_bunny_200", "scene05_bunny_200.txt", 800, 800, ""},
+    {"06_bunny_1k", "scene06_bunny_1k.txt", 800, 800, "-bounces 4"},
+    {"07_arch", "scene07_arch.txt", 800, 800, "-bounces 4 -shadows"},
+    {"07_arch_filter", "scene07_arch.txt", 200, 200, "-bounces 4 -shadows -jitter -filter"},
+};
+
+struct Options {
+    std::string a2 = "a2";
+    std::string dataDir = "data";
+    std::string outDir = ".";
+    std::string jsonFile = "bench.json";
+    std::string baselineFile;
+    std::string only;        // 只跑名字包含该字符串的场景
+    std::string build;       // 构建配置的说明, 记入结果
+    int warmup = 1;
+    int repetitions = 5;
+    int threads = 0;         // 0 表示不传 -threads, 由 a2 决定
+    double threshold = 0.1;  // 允许的相对退化
+    bool updateBaseline = false;
+};
+
+// One a2 process: its wall time and what -stats reported
+struct Run {
+    double wall;
+    double render;
+    double rays;
+    double peakMiB;
+};
+
+struct Result {
+    std::string name;
+    double wall;        // 墙钟时间的中位数
+    double render;      // 渲染阶段耗时的中位数
+    double raysPerSec;  // 全部光线数 / render
+    double peakMiB;     // 各次运行的最大值
+};
+
+void usage() {
+    std::cerr << "Usage: a2_bench [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "\t--a2 <path>           a2 executable (default: a2)\n"
+              << "\t--data <dir>          scene directory (default: data)\n"
+              << "\t--out <dir>           where the rendered images go (default: .)\n"
+              << "\t--json <file>         results file (default: bench.json)\n"
+              << "\t--baseline <file>     compare against this results file\n"
+              << "\t--update-baseline     write the results to the baseline instead\n"
+              << "\t--threshold <frac>    allowed slowdown before a regression (default: 0.1)\n"
+              << "\t--warmup <n>          untimed runs per scene (default: 1)\n"
+              << "\t--reps <n>            timed runs per scene (default: 5)\n"
+              << "\t--threads <n>         passed to a2 as -threads\n"
+              << "\t--only <substring>    run only the scenes whose name contains it\n"
+              << "\t--build <label>       build configuration recorded with the results\n";
+}
+
+bool parseOptions(int argc, char *argv[], Options &opt) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--update-baseline") {
+            opt.updateBaseline = true;
+        } else if (arg == "--a2" && hasValue) {
+            opt.a2 = argv[++i];
+        } else if (arg == "--data" && hasValue) {
+            opt.dataDir = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            opt.outDir = argv[++i];
+        } else if (arg == "--json" && hasValue) {
+            opt.jsonFile = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            opt.baselineFile = argv[++i];
+        } else if (arg == "--threshold" && hasValue) {
+            opt.threshold = atof(argv[++i]);
+        } else if (arg == "--warmup" && hasValue) {
+            opt.warmup = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--reps" && hasValue) {
+            opt.repetitions = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            opt.threads = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--only" && hasValue) {
+            opt.only = argv[++i];
+        } else if (arg == "--build" && hasValue) {
+            opt.build = argv[++i];
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    if (opt.updateBaseline && opt.baselineFile.empty()) {
+        std::cerr << "--update-baseline needs --baseline <file>" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::string quote(const std::string &s) {
+    return "\"" + s + "\"";
+}
+
+std::string joinPath(const std::string &dir, const std::string &file) {
+    if (dir.empty() || dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == '\\')
+        return dir + file;
+    return dir + "/" + file;
+}
+
+bool fileExists(const std::string &path) {
+    std::ifstream in(path.c_str());
+    return in.is_open();
+}
+
+// Number that follows key in text, e.g. number(" render ", ...) on the
+// "- time:" line of the -stats report
+bool number(const std::string &text, const char *key, double &value) {
+    size_t pos = text.find(key);
+    if (pos == std::string::npos)
+        return false;
+    const char *begin = text.c_str() + pos + strlen(key);
+    char *end;
+    value = strtod(begin, &end);
+    return end != begin;
+}
+
+// Runs a2 once and reads the -stats report from its output
+bool runOnce(const Options &opt, const Scene &scene, Run &run) {
+    std::ostringstream cmd;
+    cmd << quote(opt.a2) << " -input " << quote(joinPath(opt.dataDir, scene.file)) << " -size "
+        << scene.width << " " << scene.height << " -output "
+        << quote(joinPath(opt.outDir, std::string("bench_") + scene.name + ".png")) << " "
+        << scene.args << " -no_cache -stats";
+    if (opt.threads > 0)
+        cmd << " -threads " << opt.threads;
+    cmd << " 2>&1";
+
+    auto start = std::chrono::steady_clock::now();
+    FILE *pipe = popen(cmd.str().c_str(), "r");
+    if (!pipe) {
+        std::cerr << "Cannot run " << cmd.str() << std::endl;
+        return false;
+    }
+    std::string output;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0)
+        output.append(buf, n);
+    const int status = pclose(pipe);
+    run.wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const bool ok = status == 0;
+    double primary = 0, shadow = 0, reflection = 0;
+    run.render = run.peakMiB = 0;
+    std::istringstream lines(output);
+    std::string line;
+    bool seenTime = false, seenRays = false;
+    while (std::getline(lines, line)) {
+        if (line.compare(0, 7, "- time:") == 0)
+            seenTime = number(line, " render ", run.render);
+        else if (line.compare(0, 7, "- rays:") == 0)
+            seenRays = number(line, " primary ", primary) && number(line, " shadow ", shadow) &&
+                       number(line, " reflection ", reflection);
+        else if (line.compare(0, 11, "- peak RSS:") == 0)
+            number(line, "- peak RSS:", run.peakMiB);
+    }
+    run.rays = primary + shadow + reflection;
+    if (!ok || !seenTime || !seenRays) {
+        std::cerr << "Run failed: " << cmd.str() << "\n" << output << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    const size_t mid = v.size() / 2;
+    return v.size() % 2 ? v[mid] : 0.5 * (v[mid - 1] + v[mid]);
+}
+
+bool benchScene(const Options &opt, const Scene &scene, Result &result) {
+    Run run;
+    for (int i = 0; i < opt.warmup; i++)
+        if (!runOnce(opt, scene, run))
+            return false;
+
+    std::vector<double> walls, renders;
+    double rays = 0;
+    result.peakMiB = 0;
+    for (int i = 0; i < opt.repetitions; i++) {
+        if (!runOnce(opt, scene, run))
+            return false;
+        walls.push_back(run.wall);
+        renders.push_back(run.render);
+        rays = run.rays;  // 设置固定, 每次的光线数相同
+        result.peakMiB = std::max(result.peakMiB, run.peakMiB);
+    }
+    result.name = scene.name;
+    result.wall = median(walls);
+    result.render = median(renders);
+    result.raysPerSec = result.render > 0 ? rays / result.render : 0;
+    return true;
+}
+
+// Writes one scene per line, which is also what readResults expects
+bool writeResults(const std::string &path, const Options &opt,
+                  const std::vector<Result> &results) {
+    std::ofstream out(path.c_str());
+    if (!out.is_open())
+        return false;
+    out << "{\n";
+    out << "  \"build\": \"" << opt.build << "\",\n";
+    out << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+    out << "  \"threads\": " << opt.threads << ",\n";
+    out << "  \"warmup\": " << opt.warmup << ",\n";
+    out << "  \"repetitions\": " << opt.repetitions << ",\n";
+    out << "  \"scenes\": [\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result &r = results[i];
+        out << "    {\"name\": \"" << r.name << "\", \"wall_s\": " << r.wall
+            << ", \"render_s\": " << r.render << ", \"rays_per_s\": " << r.raysPerSec
+            << ", \"peak_rss_mib\": " << r.peakMiB << "}" << (i + 1 < results.size() ? "," : "")
+            << "\n";
+    }
+    out << "  ]\n}\n";
+    return (bool)out;
+}
+
+// String value that follows key in line, e.g. text(line, "\"name\": \"", ...)
+bool text(const std::string &line, const char *key, std::string &value) {
+    size_t begin = line.find(key);
+    if (begin == std::string::npos)
+        return false;
+    begin += strlen(key);
+    size_t end = line.find('"', begin);
+    if (end == std::string::npos)
+        return false;
+    value = line.substr(begin, end - begin);
+    return true;
+}
+
+// Reads a file written by writeResults; not a general JSON parser
+bool readResults(const std::string &path, std::string &build, std::vector<Result> &results) {
+    std::ifstream in(path.c_str());
+    if (!in.is_open())
+        return false;
+    std::string line;
+    while (std::getline(in, line)) {
+        Result r;
+        if (!text(line, "\"name\": \"", r.name)) {
+            text(line, "\"build\": \"", build);
+            continue;
+        }
+        if (number(line, "\"wall_s\":", r.wall) && number(line, "\"render_s\":", r.render) &&
+            number(line, "\"rays_per_s\":", r.raysPerSec) &&
+            number(line, "\"peak_rss_mib\":", r.peakMiB))
+            results.push_back(r);
+    }
+    return true;
+}
+
+// Prints how each scene moved against the baseline and returns the
+// number of regressions
+int compare(const std::vector<Result> &results, const std::vector<Result> &baseline,
+            double threshold) {
+    int regressions = 0;
+    for (const Result &r : results) {
+        const Result *b = nullptr;
+        for (const Result &candidate : baseline)
+            if (candidate.name == r.name)
+                b = &candidate;
+        if (!b) {
+            std::cout << r.name << ": not in baseline" << std::endl;
+            continue;
+        }
+        // 各项按"越大越差"的比值比较
+        const double wall = b->wall > 0 ? r.wall / b->wall : 1;
+        const double rays = r.raysPerSec > 0 ? b->raysPerSec / r.raysPerSec : 1;
+        const double memory = b->peakMiB > 0 ? r.peakMiB / b->peakMiB : 1;
+        const bool regressed =
+            wall > 1 + threshold || rays > 1 + threshold || memory > 1 + threshold;
+        regressions += regressed;
+        printf("%-16s wall %+6.1f%%  rays/s %+6.1f%%  memory %+6.1f%%%s\n", r.name.c_str(),
+               (wall - 1) * 100, (1 / rays - 1) * 100, (memory - 1) * 100,
+               regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+
+    std::vector<Result> results;
+    for (const Scene &scene : kScenes) {
+        if (!opt.only.empty() && std::string(scene.name).find(opt.only) == std::string::npos)
+            continue;
+        if (!fileExists(joinPath(opt.dataDir, scene.file))) {
+            std::cerr << "Skipping " << scene.name << ": " << joinPath(opt.dataDir, scene.file)
+                      << " not found" << std::endl;
+            continue;
+        }
+        Result r;
+        if (!benchScene(opt, scene, r))
+            return 2;
+        printf("%-16s wall %8.4f s  render %8.4f s  %8.3f Mrays/s  %6.0f MiB\n", r.name.c_str(),
+               r.wall, r.render, r.raysPerSec / 1e6, r.peakMiB);
+        fflush(stdout);
+        results.push_back(r);
+    }
+
+    if (!writeResults(opt.jsonFile, opt, results)) {
+        std::cerr << "Cannot write " << opt.jsonFile << std::endl;
+        return 2;
+    }
+    if (opt.baselineFile.empty())
+        return 0;
+
+    if (opt.updateBaseline) {
+        if (!writeResults(opt.baselineFile, opt, results)) {
+            std::cerr << "Cannot write " << opt.baselineFile << std::endl;
+            return 2;
+        }
+        std::cout << "Updated baseline " << opt.baselineFile << std::endl;
+        return 0;
+    }
+
+    std::vector<Result> baseline;
+    std::string baselineBuild;
+    if (!readResults(opt.baselineFile, baselineBuild, baseline)) {
+        std::cout << "No baseline at " << opt.baselineFile
+                  << "; write one with --update-baseline" << std::endl;
+        return 0;
+    }
+    std::cout << "Build \"" << opt.build << "\" against " << opt.baselineFile << " (build \""
+              << baselineBuild << "\", threshold " << opt.threshold * 100 << "%):" << std::endl;
+    const int regressions = compare(results, baseline, opt.threshold);
+    if (regressions)
+        std::cout << regressions << " regression(s)" << std::endl;
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,327 @@
+// Microbenchmarks for the intersection kernels, shading and vecmath.
+//
+// Each benchmark runs one operation over a pre-generated random set (rays,
+// hits, directions or matrices) from a fixed seed, so runs of different
+// builds time the same work. The iteration count grows until a run takes
+// at least --min_time, then that count is repeated --reps times and the
+// fastest and median times per operation are reported, in the manner of
+// Google Benchmark.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "CubeMap.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Object3D.h"
+#include "Random.h"
+#include "vecmath.h"
+
+namespace {
+
+const size_t kSetSize = 4096;  // 每个随机集合的元素个数, 2 的幂
+
+struct Options {
+    std::string dataDir = "data";
+    std::string filter;      // 只跑名字包含该字符串的测试
+    double minTime = 0.2;    // 单次计时的最短时间 (秒)
+    int repetitions = 3;
+};
+
+// Runs the operation iterations times and returns a value derived from the
+// results, which the harness keeps so the work cannot be optimized away
+typedef std::function<float(uint64_t iterations)> Body;
+
+struct Benchmark {
+    std::string name;
+    Body body;
+};
+
+volatile float g_sink;
+
+float uniform(Rng &rng, float lo, float hi) {
+    return lo + (hi - lo) * (float)(rng() * (1.0 / 4294967296.0));
+}
+
+Vector3f uniformVector(Rng &rng, float lo, float hi) {
+    return Vector3f(uniform(rng, lo, hi), uniform(rng, lo, hi), uniform(rng, lo, hi));
+}
+
+Vector3f unitVector(Rng &rng) {
+    for (;;) {
+        Vector3f v = uniformVector(rng, -1, 1);
+        float len2 = v.absSquared();
+        if (len2 > 1e-4f && len2 <= 1)
+            return v / std::sqrt(len2);
+    }
+}
+
+// Rays that start on a sphere of radius 3 * extent around center and aim
+// at a random point within extent of it, so a good share of them hits an
+// object of about that size
+std::vector<Ray> makeRays(uint64_t seed, const Vector3f &center, float extent) {
+    Rng rng(seed);
+    std::vector<Ray> rays;
+    rays.reserve(kSetSize);
+    for (size_t i = 0; i < kSetSize; i++) {
+        Vector3f origin = center + unitVector(rng) * (3 * extent);
+        Vector3f target = center + uniformVector(rng, -extent, extent);
+        rays.push_back(Ray(origin, (target - origin).normalized()));
+    }
+    return rays;
+}
+
+// Closest hit of every ray in the set against obj
+Body intersectBody(const Object3D *obj, std::vector<Ray> rays) {
+    return [obj, rays](uint64_t iterations) {
+        float sum = 0;
+        for (uint64_t i = 0; i < iterations; i++) {
+            Hit h;
+            if (obj->intersect(rays[i & (kSetSize - 1)], 0, h))
+                sum += h.getT();
+        }
+        return sum;
+    };
+}
+
+// Objects the benchmarks refer to; they live as long as the harness
+struct Fixtures {
+    Material material{Vector3f(0.8f, 0.4f, 0.2f), Vector3f(0.5f, 0.5f, 0.5f), 20};
+    std::unique_ptr<Sphere> sphere;
+    std::unique_ptr<Sphere> unitSphere;
+    std::unique_ptr<Plane> plane;
+    std::unique_ptr<Triangle> triangle;
+    std::unique_ptr<Transform> transform;
+    std::unique_ptr<Mesh> octreeMesh;
+    std::unique_ptr<Mesh> bvhMesh;
+    std::unique_ptr<CubeMap> cubemap;
+};
+
+bool fileExists(const std::string &path) {
+    std::ifstream in(path.c_str());
+    return in.is_open();
+}
+
+std::vector<Benchmark> makeBenchmarks(const Options &opt, Fixtures &f) {
+    std::vector<Benchmark> benchmarks;
+    const Vector3f origin = Vector3f::ZERO;
+
+    f.sphere.reset(new Sphere(Vector3f(0, 0, 0), 1, &f.material));
+    benchmarks.push_back(
+        {"Sphere::intersect", intersectBody(f.sphere.get(), makeRays(1, origin, 1))});
+
+    f.plane.reset(new Plane(Vector3f(0, 1, 0), 0, &f.material));
+    benchmarks.push_back(
+        {"Plane::intersect", intersectBody(f.plane.get(), makeRays(2, origin, 1))});
+
+    const Vector3f n(0, 0, 1);
+    f.triangle.reset(new Triangle(Vector3f(-1, -1, 0), Vector3f(1, -1, 0), Vector3f(0, 1, 0), n,
+                                  n, n, &f.material));
+    benchmarks.push_back(
+        {"Triangle::intersect", intersectBody(f.triangle.get(), makeRays(3, origin, 1))});
+
+    // 带旋转和非均匀缩放的变换, 内部是单位球
+    f.unitSphere.reset(new Sphere(Vector3f(0, 0, 0), 1, &f.material));
+    Matrix4f m = Matrix4f::translation(0.5f, 0, 0) * Matrix4f::rotateY(0.7f) *
+                 Matrix4f::scaling(1.5f, 0.5f, 1);
+    f.transform.reset(new Transform(m, f.unitSphere.get()));
+    benchmarks.push_back(
+        {"Transform::intersect", intersectBody(f.transform.get(), makeRays(4, origin, 1.5f))});
+
+    // 八叉树只能通过网格遍历, 同时测 BVH 作对照
+    const std::string bunny = opt.dataDir + "/models/bunny_1k.obj";
+    if (fileExists(bunny)) {
+        MeshOptions meshOptions;
+        meshOptions.cache = false;
+        f.octreeMesh.reset(new Mesh(bunny, &f.material, AccelType::Octree, meshOptions));
+        f.bvhMesh.reset(new Mesh(bunny, &f.material, AccelType::BVH, meshOptions));
+        Box box;
+        f.octreeMesh->getBounds(box);
+        const Vector3f center = 0.5f * (box.mn + box.mx);
+        const float extent = 0.5f * (box.mx - box.mn).abs();
+        const std::vector<Ray> rays = makeRays(5, center, extent);
+        benchmarks.push_back(
+            {"Octree::intersect (bunny_1k)", intersectBody(f.octreeMesh.get(), rays)});
+        benchmarks.push_back(
+            {"BVH::intersect (bunny_1k)", intersectBody(f.bvhMesh.get(), rays)});
+    } else {
+        std::cerr << "Skipping the mesh benchmarks: " << bunny << " not found" << std::endl;
+    }
+
+    {
+        Rng rng(6);
+        std::vector<Ray> rays;
+        std::vector<Hit> hits;
+        std::vector<Vector3f> toLight;
+        for (size_t i = 0; i < kSetSize; i++) {
+            rays.push_back(Ray(Vector3f::ZERO, unitVector(rng)));
+            hits.push_back(Hit(uniform(rng, 1, 10), &f.material, unitVector(rng)));
+            toLight.push_back(unitVector(rng));
+        }
+        const Material *material = &f.material;
+        benchmarks.push_back({"Material::shade", [=](uint64_t iterations) {
+            Vector3f sum;
+            const Vector3f intensity(1, 1, 1);
+            for (uint64_t i = 0; i < iterations; i++) {
+                size_t k = i & (kSetSize - 1);
+                sum += material->shade(rays[k], hits[k], toLight[k], intensity);
+            }
+            return sum.x() + sum.y() + sum.z();
+        }});
+    }
+
+    const std::string church = opt.dataDir + "/tex/church";
+    if (fileExists(church + "/left.png")) {
+        f.cubemap.reset(new CubeMap(church));
+        Rng rng(7);
+        std::vector<Vector3f> dirs;
+        for (size_t i = 0; i < kSetSize; i++)
+            dirs.push_back(unitVector(rng));
+        const CubeMap *cubemap = f.cubemap.get();
+        benchmarks.push_back({"CubeMap::getTexel", [=](uint64_t iterations) {
+            Vector3f sum;
+            for (uint64_t i = 0; i < iterations; i++)
+                sum += cubemap->getTexel(dirs[i & (kSetSize - 1)]);
+            return sum.x() + sum.y() + sum.z();
+        }});
+    } else {
+        std::cerr << "Skipping CubeMap::getTexel: " << church << " not found" << std::endl;
+    }
+
+    {
+        Rng rng(8);
+        std::vector<Vector3f> a, b;
+        std::vector<Vector4f> v4;
+        std::vector<Matrix4f> mats;
+        for (size_t i = 0; i < kSetSize; i++) {
+            a.push_back(uniformVector(rng, -1, 1));
+            b.push_back(uniformVector(rng, -1, 1));
+            v4.push_back(Vector4f(uniformVector(rng, -1, 1), 1));
+            Matrix4f r = Matrix4f::rotation(unitVector(rng), uniform(rng, 0, 6.28f));
+            mats.push_back(Matrix4f::translation(uniformVector(rng, -5, 5)) * r *
+                           Matrix4f::uniformScaling(uniform(rng, 0.5f, 2)));
+        }
+        benchmarks.push_back({"Vector3f::dot", [=](uint64_t iterations) {
+            float sum = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                size_t k = i & (kSetSize - 1);
+                sum += Vector3f::dot(a[k], b[k]);
+            }
+            return sum;
+        }});
+        benchmarks.push_back({"Vector3f::cross", [=](uint64_t iterations) {
+            Vector3f sum;
+            for (uint64_t i = 0; i < iterations; i++) {
+                size_t k = i & (kSetSize - 1);
+                sum += Vector3f::cross(a[k], b[k]);
+            }
+            return sum.x() + sum.y() + sum.z();
+        }});
+        benchmarks.push_back({"Vector3f::normalized", [=](uint64_t iterations) {
+            Vector3f sum;
+            for (uint64_t i = 0; i < iterations; i++)
+                sum += b[i & (kSetSize - 1)].normalized();
+            return sum.x() + sum.y() + sum.z();
+        }});
+        benchmarks.push_back({"Matrix4f * Vector4f", [=](uint64_t iterations) {
+            Vector4f sum;
+            for (uint64_t i = 0; i < iterations; i++) {
+                size_t k = i & (kSetSize - 1);
+                sum = sum + mats[k] * v4[k];
+            }
+            return sum.x() + sum.y() + sum.z() + sum.w();
+        }});
+        benchmarks.push_back({"Matrix4f * Matrix4f", [=](uint64_t iterations) {
+            float sum = 0;
+            for (uint64_t i = 0; i < iterations; i++) {
+                size_t k = i & (kSetSize - 1);
+                sum += (mats[k] * mats[(k + 1) & (kSetSize - 1)])(0, 3);
+            }
+            return sum;
+        }});
+        benchmarks.push_back({"Matrix4f::inverse", [=](uint64_t iterations) {
+            float sum = 0;
+            for (uint64_t i = 0; i < iterations; i++)
+                sum += mats[i & (kSetSize - 1)].inverse()(0, 3);
+            return sum;
+        }});
+    }
+    return benchmarks;
+}
+
+double timeRun(const Body &body, uint64_t iterations) {
+    auto start = std::chrono::steady_clock::now();
+    g_sink = body(iterations);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void runBenchmark(const Options &opt, const Benchmark &b) {
+    // 迭代次数按上次的耗时估算, 每次最多放大 10 倍
+    uint64_t iterations = 1;
+    double seconds = timeRun(b.body, iterations);
+    while (seconds < opt.minTime) {
+        double scale = seconds > 0 ? 1.4 * opt.minTime / seconds : 10;
+        iterations = (uint64_t)(iterations * std::min(std::max(scale, 2.0), 10.0));
+        seconds = timeRun(b.body, iterations);
+    }
+
+    std::vector<double> perOp;
+    for (int r = 0; r < opt.repetitions; r++)
+        perOp.push_back(timeRun(b.body, iterations) * 1e9 / iterations);
+    std::sort(perOp.begin(), perOp.end());
+    printf("%-30s %12llu %10.2f ns %10.2f ns\n", b.name.c_str(), (unsigned long long)iterations,
+           perOp[0], perOp[perOp.size() / 2]);
+    fflush(stdout);
+}
+
+void usage() {
+    std::cerr << "Usage: a2_micro [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "\t--data <dir>          directory with models/ and tex/ (default: data)\n"
+              << "\t--filter <substring>  run only the benchmarks whose name contains it\n"
+              << "\t--min_time <seconds>  shortest timed run (default: 0.2)\n"
+              << "\t--reps <n>            timed runs per benchmark (default: 3)\n";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--data" && hasValue) {
+            opt.dataDir = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            opt.filter = argv[++i];
+        } else if (arg == "--min_time" && hasValue) {
+            opt.minTime = std::max(1e-3, atof(argv[++i]));
+        } else if (arg == "--reps" && hasValue) {
+            opt.repetitions = std::max(1, atoi(argv[++i]));
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            usage();
+            return 2;
+        }
+    }
+
+    Fixtures fixtures;
+    std::vector<Benchmark> benchmarks = makeBenchmarks(opt, fixtures);
+
+    printf("%-30s %12s %13s %13s\n", "Benchmark", "Iterations", "Min", "Median");
+    for (const Benchmark &b : benchmarks)
+        if (opt.filter.empty() || b.name.find(opt.filter) != std::string::npos)
+            runBenchmark(opt, b);
+    return 0;
+}
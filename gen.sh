@@ -1,12 +1,15 @@
-/home/ethan/starter2/build/a2 -input data/scene01_plane.txt     -output output/01.png -size 1080 1080
-/home/ethan/starter2/build/a2 -input data/scene02_cube.txt      -output output/02.png -size 1080 1080 
-/home/ethan/starter2/build/a2 -input data/scene03_sphere.txt    -output output/03.png -size 1080 1080
-/home/ethan/starter2/build/a2 -input data/scene04_axes.txt      -output output/04.png -size 1080 1080
-/home/ethan/starter2/build/a2 -input data/scene05_bunny_200.txt -output output/05.png -size 1080 1080
+# 所有图片在同一进程中渲染, 共享网格与加速结构 (见 src/Batch.h)
+/home/ethan/starter2/build/a2 -jobs /dev/stdin -size 1080 1080 -threads 0 <<'EOF'
+-input data/scene01_plane.txt     -output output/01.png
+-input data/scene02_cube.txt      -output output/02.png
+-input data/scene03_sphere.txt    -output output/03.png
+-input data/scene04_axes.txt      -output output/04.png
+-input data/scene05_bunny_200.txt -output output/05.png
 
-/home/ethan/starter2/build/a2 -input data/scene06_bunny_1k.txt    -output output/06_1k.png   -size 1080 1080 -bounces 100 -filter
-/home/ethan/starter2/build/a2 -input data/scene06_bunny_100w.txt  -output output/06_100w.png -size 1080 1080 -bounces 100 -filter
-/home/ethan/starter2/build/a2 -input data/scene07_arch.txt        -output output/07.png               -size 1080 1080 -shadows -bounces 100
-/home/ethan/starter2/build/a2 -input data/scene07_arch.txt        -output output/07_jitter.png        -size 1080 1080 -shadows -bounces 100 -jitter
-/home/ethan/starter2/build/a2 -input data/scene07_arch.txt        -output output/07_filter.png        -size 1080 1080 -shadows -bounces 100 -filter
-/home/ethan/starter2/build/a2 -input data/scene07_arch.txt        -output output/07-jitter_filter.png -size 1080 1080 -shadows -bounces 100 -jitter -filter
\ No newline at end of file
+-input data/scene06_bunny_1k.txt    -output output/06_1k.png   -bounces 100 -filter
+-input data/scene06_bunny_100w.txt  -output output/06_100w.png -bounces 100 -filter
+-input data/scene07_arch.txt        -output output/07.png               -shadows -bounces 100
+-input data/scene07_arch.txt        -output output/07_jitter.png        -shadows -bounces 100 -jitter
+-input data/scene07_arch.txt        -output output/07_filter.png        -shadows -bounces 100 -filter
+-input data/scene07_arch.txt        -output output/07-jitter_filter.png -shadows -bounces 100 -jitter -filter
+EOF
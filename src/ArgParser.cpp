@@ -1,5 +1,6 @@
 #include "ArgParser.h"
 
+#include <algorithm>
 #include <cstring>
 #include <cassert>
 #include <cstdio>
@@ -30,6 +31,18 @@ ArgParser::ArgParser(int argc, const char *argv[])
             assert(i < argc);
             normals_file = argv[i];
         }
+        else if (!strcmp(argv[i], "-albedo")) // 反照率图
+        {
+            i++;
+            assert(i < argc);
+            albedo_file = argv[i];
+        }
+        else if (!strcmp(argv[i], "-ids")) // 物体编号图
+        {
+            i++;
+            assert(i < argc);
+            ids_file = argv[i];
+        }
         else if (!strcmp(argv[i], "-size")) // 图片大小
         {
             i++;
@@ -52,16 +65,38 @@ ArgParser::ArgParser(int argc, const char *argv[])
             assert(i < argc);
             depth_file = argv[i];
         }
-        else if (!strcmp(argv[i], "-bounces")) // 光追最大递归深度
+        else if (!strcmp(argv[i], "-bounces")) // 光线最大反弹次数
         {
             i++;
             assert(i < argc);
             bounces = atoi(argv[i]);
         }
+        else if (!strcmp(argv[i], "-roulette")) // 俄罗斯轮盘赌的起始反弹次数
+        {
+            i++;
+            assert(i < argc);
+            roulette = atoi(argv[i]);
+        }
         else if (!strcmp(argv[i], "-shadows")) // 投射阴影
         {
             shadows = true;
         }
+        else if (!strcmp(argv[i], "-accel")) // 网格加速结构
+        {
+            i++;
+            assert(i < argc);
+            accel = argv[i];
+        }
+        else if (!strcmp(argv[i], "-cache_dir")) // 网格缓存目录
+        {
+            i++;
+            assert(i < argc);
+            cache_dir = argv[i];
+        }
+        else if (!strcmp(argv[i], "-no_cache")) // 不读写网格缓存
+        {
+            mesh_cache = false;
+        }
 
         // supersampling
         else if (strcmp(argv[i], "-jitter") == 0)
@@ -71,6 +106,83 @@ ArgParser::ArgParser(int argc, const char *argv[])
         else if (strcmp(argv[i], "-filter") == 0)
         {
             filter = true;
+            // 可选的滤波核名称
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                i++;
+                if (!Filter::parseKernel(argv[i], filter_kernel))
+                {
+                    printf("Unknown filter kernel '%s'\n", argv[i]);
+                    exit(1);
+                }
+            }
+        }
+        else if (!strcmp(argv[i], "-samples")) // 每个像素的采样数
+        {
+            i++;
+            assert(i < argc);
+            min_samples = atoi(argv[i]);
+            i++;
+            assert(i < argc);
+            max_samples = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-adaptive")) // 自适应采样的误差阈值
+        {
+            i++;
+            assert(i < argc);
+            adaptive = (float)atof(argv[i]);
+        }
+
+        // progressive rendering
+        else if (!strcmp(argv[i], "-progressive")) // 渐进渲染的遍数
+        {
+            i++;
+            assert(i < argc);
+            progressive = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-checkpoint")) // 累加缓冲的检查点文件
+        {
+            i++;
+            assert(i < argc);
+            checkpoint_file = argv[i];
+        }
+        else if (!strcmp(argv[i], "-write_every")) // 写出间隔秒数
+        {
+            i++;
+            assert(i < argc);
+            write_interval = (float)atof(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-write_passes")) // 写出间隔遍数
+        {
+            i++;
+            assert(i < argc);
+            write_passes = atoi(argv[i]);
+        }
+
+        // parallelism
+        else if (!strcmp(argv[i], "-threads")) // 渲染线程数
+        {
+            i++;
+            assert(i < argc);
+            threads = atoi(argv[i]);
+        }
+        else if (!strcmp(argv[i], "-packets")) // 主光线以 2x2 光线包求交
+        {
+            packets = true;
+        }
+        else if (!strcmp(argv[i], "-wavefront")) // 按反弹深度成批求交
+        {
+            wavefront = true;
+        }
+        else if (!strcmp(argv[i], "-stats")) // 输出渲染统计
+        {
+            stats = 1;
+        }
+        else if (!strcmp(argv[i], "-jobs")) // 批量渲染的任务文件
+        {
+            i++;
+            assert(i < argc);
+            jobs_file = argv[i];
         }
         else
         {
@@ -79,17 +191,37 @@ ArgParser::ArgParser(int argc, const char *argv[])
         }
     }
 
+    // 采样数至少为 1, 初始采样数不超过最大采样数
+    max_samples = std::max(max_samples, 1);
+    min_samples = std::min(std::max(min_samples, 1), max_samples);
+
     std::cout << "Args:\n";
     std::cout << "- input: " << input_file << std::endl;
     std::cout << "- output: " << output_file << std::endl;
     std::cout << "- depth_file: " << depth_file << std::endl;
     std::cout << "- normals_file: " << normals_file << std::endl;
+    std::cout << "- albedo_file: " << albedo_file << std::endl;
+    std::cout << "- ids_file: " << ids_file << std::endl;
     std::cout << "- width: " << width << std::endl;
     std::cout << "- height: " << height << std::endl;
     std::cout << "- depth_min: " << depth_min << std::endl;
     std::cout << "- depth_max: " << depth_max << std::endl;
     std::cout << "- bounces: " << bounces << std::endl;
+    std::cout << "- roulette: " << roulette << std::endl;
     std::cout << "- shadows: " << shadows << std::endl;
+    std::cout << "- accel: " << accel << std::endl;
+    std::cout << "- mesh_cache: " << mesh_cache << std::endl;
+    std::cout << "- cache_dir: " << cache_dir << std::endl;
+    std::cout << "- samples: " << min_samples << " " << max_samples << std::endl;
+    std::cout << "- adaptive: " << adaptive << std::endl;
+    std::cout << "- progressive: " << progressive << std::endl;
+    std::cout << "- checkpoint_file: " << checkpoint_file << std::endl;
+    std::cout << "- write_every: " << write_interval << " s, " << write_passes << " passes" << std::endl;
+    std::cout << "- threads: " << threads << std::endl;
+    std::cout << "- packets: " << packets << std::endl;
+    std::cout << "- wavefront: " << wavefront << std::endl;
+    std::cout << "- stats: " << stats << std::endl;
+    std::cout << "- jobs_file: " << jobs_file << std::endl;
 }
 
 void ArgParser::defaultValues()
@@ -99,6 +231,8 @@ void ArgParser::defaultValues()
     output_file = "";
     depth_file = "";
     normals_file = "";
+    albedo_file = "";
+    ids_file = "";
     width = 600;
     height = 600;
     stats = 0;
@@ -107,9 +241,31 @@ void ArgParser::defaultValues()
     depth_min = 0;
     depth_max = 1;
     bounces = 0;
+    roulette = 0;
     shadows = false;
+    accel = "";
+    mesh_cache = true;
+    cache_dir = "";
 
     // sampling
     jitter = false;
     filter = false;
+    filter_kernel = Filter::Gaussian;
+    min_samples = 4;
+    max_samples = 16;
+    adaptive = 0;
+
+    // progressive rendering
+    progressive = 0;
+    checkpoint_file = "";
+    write_interval = 10;
+    write_passes = 0;
+
+    // parallelism
+    threads = 1;
+    packets = false;
+    wavefront = false;
+
+    // batch
+    jobs_file = "";
 }
@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "Filter.h"
+
 class ArgParser {
 public:
     ArgParser(int argc, const char *argv[]);
@@ -16,19 +18,43 @@ public:
     std::string output_file; // 输出文件
     std::string depth_file; // 深度文件
     std::string normals_file; // 法线文件
+    std::string albedo_file; // 反照率文件
+    std::string ids_file; // 物体编号文件
     int width; // 图片宽度
     int height; // 图片高度
-    int stats;
+    int stats; // 输出渲染统计
 
     // rendering options
     float depth_min;
     float depth_max;
-    int bounces; // 光追最大递归深度
+    int bounces; // 光线最大反弹次数
+    int roulette; // 从第几次反弹起以俄罗斯轮盘赌终止路径, 0 表示不使用
     bool shadows; // 是否投射阴影
+    std::string accel; // 网格加速结构 octree/bvh, 为空时由场景文件决定
+    bool mesh_cache; // 读写二进制网格缓存
+    std::string cache_dir; // 网格缓存目录, 为空时写在 .obj 文件旁
 
     // supersampling
     bool jitter;
     bool filter;
+    Filter::Kernel filter_kernel; // 重建滤波核
+    int min_samples; // 自适应采样时每个像素的初始采样数
+    int max_samples; // 每个像素的最大采样数, 也是抖动采样的采样数
+    float adaptive; // 自适应采样的误差阈值, 0 表示不使用
+
+    // progressive rendering
+    int progressive; // 渐进渲染的遍数, 每遍每个像素一个采样, 0 表示不使用
+    std::string checkpoint_file; // 渐进渲染的累加缓冲文件, 存在时从中继续
+    float write_interval; // 渐进渲染时每隔多少秒写出一次图片和检查点
+    int write_passes; // 每隔多少遍写出一次, 0 表示只按时间
+
+    // parallelism
+    int threads; // 渲染线程数, 0 表示使用全部硬件线程
+    bool packets; // 主光线以 SIMD 光线包求交
+    bool wavefront; // 图块内同一反弹深度的光线成批求交
+
+    // batch
+    std::string jobs_file; // 任务文件, 每行一组参数, 在同一进程中渲染 (见 Batch.h)
 
 private:
     void defaultValues();
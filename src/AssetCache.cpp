@@ -0,0 +1,45 @@
+#include "AssetCache.h"
+
+#include "CubeMap.h"
+
+#include <exception>
+
+template <typename T, typename Load>
+std::shared_ptr<const T> AssetCache::find(Entries<T>& entries, const std::string& key,
+                                          Load load) {
+    std::promise<std::shared_ptr<const T>> loaded;
+    std::shared_future<std::shared_ptr<const T>> entry;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            entry = it->second;
+        } else {
+            entries[key] = loaded.get_future().share();
+        }
+    }
+    // 其他线程正在或已经加载
+    if (entry.valid())
+        return entry.get();
+
+    std::shared_ptr<const T> asset;
+    try {
+        asset.reset(load());
+    } catch (...) {
+        // 让等待同一资源的线程收到同样的异常, 而不是 broken_promise
+        loaded.set_exception(std::current_exception());
+        throw;
+    }
+    loaded.set_value(asset);
+    return asset;
+}
+
+std::shared_ptr<const Mesh> AssetCache::getMesh(const std::string& filename, AccelType accel,
+                                                const MeshOptions& options) {
+    const std::string key = std::string(Mesh::accelTypeName(accel)) + ":" + filename;
+    return find(_meshes, key, [&]() { return new Mesh(filename, nullptr, accel, options); });
+}
+
+std::shared_ptr<const CubeMap> AssetCache::getCubeMap(const std::string& directory) {
+    return find(_cubeMaps, directory, [&]() { return new CubeMap(directory); });
+}
@@ -0,0 +1,44 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include "Mesh.h"
+
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class CubeMap;
+
+// Meshes and cube maps shared by the scenes of one process, so a batch
+// of jobs that reference the same files reads each of them and builds
+// each acceleration structure once.
+//
+// Assets are keyed by path (and acceleration structure) and live as long
+// as the cache or the last scene using them. Any thread may ask: the
+// first one loads an asset while the others wait for it, and different
+// assets load concurrently.
+class AssetCache
+{
+  public:
+    // The geometry of filename without a material, see the sharing
+    // constructor of Mesh. options are those of the first request.
+    std::shared_ptr<const Mesh> getMesh(const std::string &filename, AccelType accel,
+                                        const MeshOptions &options);
+    std::shared_ptr<const CubeMap> getCubeMap(const std::string &directory);
+
+  private:
+    template <typename T>
+    using Entries = std::map<std::string, std::shared_future<std::shared_ptr<const T>>>;
+
+    // the asset stored under key, calling load() if it is the first request
+    template <typename T, typename Load>
+    std::shared_ptr<const T> find(Entries<T> &entries, const std::string &key, Load load);
+
+    std::mutex _mutex;           // 保护两个表, 加载时不持有
+    Entries<Mesh> _meshes;       // 键为 "加速结构:路径"
+    Entries<CubeMap> _cubeMaps;  // 键为目录
+};
+
+#endif  // ASSET_CACHE_H
@@ -0,0 +1,244 @@
+#include "BVH.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// SAH cost of traversing one node relative to testing one primitive
+const float kTraversalCost = 1.0f;
+const float kIntersectCost = 1.0f;
+
+// below this depth the builder falls back to median splits, which
+// bounds the tree depth by BVH::kStackSize
+const int kMaxSahDepth = BVH::kStackSize / 2;
+
+}  // namespace
+
+void
+BVH::build(const std::vector<Box> &primBounds, int leafAlign, ThreadPool *pool)
+{
+    _nodes.reset();
+    _prims.reset();
+    if (primBounds.empty()) {
+        return;
+    }
+
+    BuildContext ctx;
+    ctx.bp.resize(primBounds.size());
+    ctx.prims.resize(primBounds.size());
+    ctx.pool = pool;
+    for (size_t ii = 0; ii < primBounds.size(); ii++) {
+        ctx.bp[ii].box = primBounds[ii];
+        ctx.bp[ii].centroid = primBounds[ii].centroid();
+        ctx.prims[ii] = (int)ii;
+    }
+
+    // a binary tree with at least one primitive per leaf
+    _leafAlign = std::max(1, leafAlign);
+    std::vector<BVHNode> nodes;
+    nodes.reserve(2 * primBounds.size());
+    buildNode(ctx, nodes, 0, (int)ctx.bp.size(), 0);
+    if (_leafAlign > 1) {
+        alignLeaves(nodes, ctx.prims, _leafAlign);
+    }
+    _nodes.assign(std::move(nodes));
+    _prims.assign(std::move(ctx.prims));
+}
+
+void
+BVH::view(const BVHNode *nodes, size_t numNodes, const int *prims, size_t numPrims,
+          int leafAlign)
+{
+    _nodes.view(nodes, numNodes);
+    _prims.view(prims, numPrims);
+    _leafAlign = std::max(1, leafAlign);
+}
+
+///@brief moves the primitives of every leaf to a multiple of leafAlign
+void
+BVH::alignLeaves(std::vector<BVHNode> &nodes, std::vector<int> &prims, int leafAlign)
+{
+    // leaves appear in the node array in the order of their ranges
+    std::vector<int> aligned;
+    aligned.reserve(prims.size() + prims.size() / 2);
+    for (BVHNode &n : nodes) {
+        if (!n.isLeaf()) {
+            continue;
+        }
+        while (aligned.size() % leafAlign) {
+            aligned.push_back(-1);
+        }
+        int first = (int)aligned.size();
+        aligned.insert(aligned.end(), prims.begin() + n.offset,
+                       prims.begin() + n.offset + n.count);
+        n.offset = first;
+    }
+    while (aligned.size() % leafAlign) {
+        aligned.push_back(-1);
+    }
+    prims.swap(aligned);
+}
+
+///@brief builds the subtree over prims[begin, end) into nodes and returns its index
+int
+BVH::buildNode(BuildContext &ctx, std::vector<BVHNode> &nodes, int begin, int end,
+               int depth) const
+{
+    const std::vector<BuildPrim> &bp = ctx.bp;
+    std::vector<int> &prims = ctx.prims;
+
+    int index = (int)nodes.size();
+    nodes.push_back(BVHNode());
+
+    Box box = Box::empty();
+    Box cbox = Box::empty();
+    for (int ii = begin; ii < end; ii++) {
+        box.extend(bp[prims[ii]].box);
+        cbox.extend(bp[prims[ii]].centroid);
+    }
+    nodes[index].box = box;
+
+    int count = end - begin;
+    int axis = 0;
+    Vector3f extent = cbox.mx - cbox.mn;
+    for (int dim = 1; dim < 3; dim++) {
+        if (extent[dim] > extent[axis]) {
+            axis = dim;
+        }
+    }
+
+    // primitives of an aligned leaf are tested leafAlign at a time
+    auto blocks = [&](int n) { return (n + _leafAlign - 1) / _leafAlign; };
+
+    auto makeLeaf = [&]() {
+        nodes[index].offset = begin;
+        nodes[index].count = (uint16_t)count;
+        nodes[index].axis = 0;
+        return index;
+    };
+
+    if (count <= 2) {
+        return makeLeaf();
+    }
+
+    int mid = begin;
+    if (extent[axis] <= 0) {
+        // all centroids coincide, nothing to gain from SAH
+        if (count <= kMaxLeafSize) {
+            return makeLeaf();
+        }
+        mid = begin + count / 2;
+    } else if (depth >= kMaxSahDepth) {
+        mid = begin + count / 2;
+        std::nth_element(prims.begin() + begin, prims.begin() + mid,
+                         prims.begin() + end, [&](int a, int b) {
+                             return bp[a].centroid[axis] < bp[b].centroid[axis];
+                         });
+    } else {
+        // binned SAH over every axis with a non-degenerate extent
+        struct Bin
+        {
+            Box box;
+            int count;
+        };
+        float bestCost = std::numeric_limits<float>::infinity();
+        int bestAxis = -1;
+        int bestSplit = 0;
+        for (int dim = 0; dim < 3; dim++) {
+            if (extent[dim] <= 0) {
+                continue;
+            }
+            Bin bins[kNumBins];
+            for (int bi = 0; bi < kNumBins; bi++) {
+                bins[bi].box = Box::empty();
+                bins[bi].count = 0;
+            }
+            float scale = kNumBins / extent[dim];
+            for (int ii = begin; ii < end; ii++) {
+                const BuildPrim &p = bp[prims[ii]];
+                int bi = std::min(kNumBins - 1, (int)((p.centroid[dim] - cbox.mn[dim]) * scale));
+                bins[bi].box.extend(p.box);
+                bins[bi].count++;
+            }
+
+            // sweep from the right to get the cost of every right side
+            float rightArea[kNumBins];
+            int rightCount[kNumBins];
+            Box acc = Box::empty();
+            int n = 0;
+            for (int bi = kNumBins - 1; bi > 0; bi--) {
+                acc.extend(bins[bi].box);
+                n += bins[bi].count;
+                rightArea[bi] = acc.area();
+                rightCount[bi] = n;
+            }
+            acc = Box::empty();
+            n = 0;
+            for (int bi = 0; bi < kNumBins - 1; bi++) {
+                acc.extend(bins[bi].box);
+                n += bins[bi].count;
+                if (n == 0 || rightCount[bi + 1] == 0) {
+                    continue;
+                }
+                float cost = acc.area() * blocks(n) + rightArea[bi + 1] * blocks(rightCount[bi + 1]);
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = dim;
+                    bestSplit = bi;
+                }
+            }
+        }
+
+        float leafCost = kIntersectCost * blocks(count);
+        float splitCost = kTraversalCost + kIntersectCost * bestCost / box.area();
+        if (bestAxis < 0 || (count <= kMaxLeafSize && leafCost <= splitCost)) {
+            if (count <= kMaxLeafSize) {
+                return makeLeaf();
+            }
+        }
+
+        if (bestAxis >= 0) {
+            axis = bestAxis;
+            float scale = kNumBins / extent[axis];
+            auto it = std::partition(prims.begin() + begin, prims.begin() + end, [&](int p) {
+                int bi = std::min(kNumBins - 1,
+                                  (int)((bp[p].centroid[axis] - cbox.mn[axis]) * scale));
+                return bi <= bestSplit;
+            });
+            mid = (int)(it - prims.begin());
+        }
+        if (mid == begin || mid == end) {
+            mid = begin + count / 2;
+        }
+    }
+
+    nodes[index].count = 0;
+    nodes[index].axis = (uint16_t)axis;
+    if (ctx.pool && count >= kParallelBuildSize) {
+        // the second child goes to another thread and is appended after
+        // the first one, with its inner node offsets moved along
+        std::vector<BVHNode> second;
+        TaskGroup group;
+        ctx.pool->submit(group, [&]() {
+            second.reserve(2 * (end - mid));
+            buildNode(ctx, second, mid, end, depth + 1);
+        });
+        buildNode(ctx, nodes, begin, mid, depth + 1);
+        ctx.pool->wait(group);
+        int base = (int)nodes.size();
+        for (BVHNode &n : second) {
+            if (!n.isLeaf()) {
+                n.offset += base;
+            }
+        }
+        nodes[index].offset = base;
+        nodes.insert(nodes.end(), second.begin(), second.end());
+    } else {
+        buildNode(ctx, nodes, begin, mid, depth + 1);
+        nodes[index].offset = buildNode(ctx, nodes, mid, end, depth + 1);
+    }
+    return index;
+}
@@ -0,0 +1,413 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "Box.h"
+#include "Buffer.h"
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Simd.h"
+#include "Stats.h"
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// Node of a flattened BVH, stored depth first:
+// the first child of an inner node directly follows it in the array,
+// the second child sits at index `offset`.
+struct BVHNode
+{
+    Box box;          // 节点包围盒
+    int32_t offset;   // 叶节点: 第一个图元在图元序列中的位置; 内部节点: 第二个子节点的下标
+    uint16_t count;   // 叶节点中的图元数, 内部节点为0
+    uint16_t axis;    // 内部节点的划分轴
+
+    bool isLeaf() const {
+        return count > 0;
+    }
+};
+
+// Bounding volume hierarchy built with binned SAH over arbitrary primitives,
+// each described only by its bounding box.
+// Leaves reference contiguous ranges of getPrimitives().
+class BVH
+{
+  public:
+    // leaves hold at most this many primitives
+    static const int kMaxLeafSize = 8;
+    // number of SAH bins per axis
+    static const int kNumBins = 16;
+    // fixed traversal stack; the builder keeps the tree shallower than this
+    static const int kStackSize = 64;
+    // nodes with at least this many primitives build a subtree as a task
+    static const int kParallelBuildSize = 16 * 1024;
+
+    // With leafAlign > 1 the primitives of every leaf start at a multiple
+    // of leafAlign in getPrimitives(), padded with -1 entries, so an owner
+    // can keep SIMD blocks of primitives in leaf order.
+    // With a pool large subtrees are built in parallel; the tree is the
+    // same for any number of threads.
+    void build(const std::vector<Box> &primBounds, int leafAlign = 1,
+               ThreadPool *pool = nullptr);
+
+    // Uses nodes and primitives stored elsewhere, e.g. in a mapped cache
+    // file, instead of building them. Nothing is copied, so the memory
+    // must outlive the BVH.
+    void view(const BVHNode *nodes, size_t numNodes, const int *prims, size_t numPrims,
+              int leafAlign);
+
+    bool empty() const {
+        return _nodes.empty();
+    }
+
+    const Box &getBounds() const {
+        assert(!empty());
+        return _nodes[0].box;
+    }
+
+    const Buffer<BVHNode> &getNodes() const {
+        return _nodes;
+    }
+
+    // primitive indices in leaf order
+    const Buffer<int> &getPrimitives() const {
+        return _prims;
+    }
+
+    int getLeafAlign() const {
+        return _leafAlign;
+    }
+
+    // Finds the closest hit along the ray.
+    // intersectPrim(prim) tests one primitive and updates hit if it is
+    // closer. Children are visited front to back and subtrees that start
+    // beyond the current hit.getT() are skipped.
+    template <typename IntersectPrim>
+    bool intersect(const Ray &ray, float tmin, Hit &hit,
+                   IntersectPrim intersectPrim) const
+    {
+        return intersectLeaves(ray, tmin, hit, [&](int first, int count) {
+            bool result = false;
+            for (int ii = first; ii < first + count; ii++) {
+                if (intersectPrim(_prims[ii])) {
+                    result = true;
+                }
+            }
+            return result;
+        });
+    }
+
+    // Closest hit for the packet lanes in mask, hits[i] belongs to lane i.
+    // intersectPrimPacket(prim, lanes) tests one primitive against several
+    // lanes and returns the lanes it updated. Once a single lane is left in
+    // a subtree it is finished with the scalar traversal and
+    // intersectPrim(prim, ray, hit). Returns the lanes that found a hit.
+    template <typename IntersectPrim, typename IntersectPrimPacket>
+    int intersectPacket(const RayPacket &rays, int mask, float tmin, Hit *hits,
+                        IntersectPrim intersectPrim,
+                        IntersectPrimPacket intersectPrimPacket) const
+    {
+        return intersectPacketLeaves(
+            rays, mask, tmin, hits,
+            [&](int first, int count, const Ray &ray, Hit &hit) {
+                bool result = false;
+                for (int ii = first; ii < first + count; ii++) {
+                    if (intersectPrim(_prims[ii], ray, hit)) {
+                        result = true;
+                    }
+                }
+                return result;
+            },
+            [&](int first, int count, int lanes) {
+                int updated = 0;
+                for (int ii = first; ii < first + count; ii++) {
+                    updated |= intersectPrimPacket(_prims[ii], lanes);
+                }
+                return updated;
+            });
+    }
+
+    // Any-hit query: returns true as soon as occludedPrim(prim) reports a
+    // primitive blocking the ray within [tmin, tmax].
+    template <typename OccludedPrim>
+    bool occluded(const Ray &ray, float tmin, float tmax,
+                  OccludedPrim occludedPrim) const
+    {
+        return occludedLeaves(ray, tmin, tmax, [&](int first, int count) {
+            for (int ii = first; ii < first + count; ii++) {
+                if (occludedPrim(_prims[ii])) {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    // Leaf level variants of the queries above. The callbacks receive a
+    // leaf as the range [first, first + count) of getPrimitives() and
+    // test all of its primitives at once.
+    template <typename IntersectLeaf>
+    bool intersectLeaves(const Ray &ray, float tmin, Hit &hit,
+                         IntersectLeaf intersectLeaf) const
+    {
+        return intersectFrom(0, ray, tmin, hit, intersectLeaf);
+    }
+
+    template <typename IntersectLeaf, typename IntersectLeafPacket>
+    int intersectPacketLeaves(const RayPacket &rays, int mask, float tmin, Hit *hits,
+                              IntersectLeaf intersectLeaf,
+                              IntersectLeafPacket intersectLeafPacket) const;
+
+    template <typename OccludedLeaf>
+    bool occludedLeaves(const Ray &ray, float tmin, float tmax,
+                        OccludedLeaf occludedLeaf) const;
+
+  private:
+    struct BuildPrim
+    {
+        Box box;
+        Vector3f centroid;
+    };
+
+    // state shared by the build tasks
+    struct BuildContext
+    {
+        std::vector<BuildPrim> bp;
+        std::vector<int> prims;  // 各任务只重排自己的区间
+        ThreadPool *pool;
+    };
+
+    int buildNode(BuildContext &ctx, std::vector<BVHNode> &nodes, int begin, int end,
+                  int depth) const;
+    static void alignLeaves(std::vector<BVHNode> &nodes, std::vector<int> &prims,
+                            int leafAlign);
+
+    // closest-hit traversal of the subtree rooted at node
+    template <typename IntersectLeaf>
+    bool intersectFrom(int node, const Ray &ray, float tmin, Hit &hit,
+                       IntersectLeaf intersectLeaf) const;
+
+    // lanes of the packet whose [tmin, hit t] overlaps the box
+    static int intersectBoxPacket(const Box &box, const RayPacket &rays,
+                                  int mask, float tmin, const Hit *hits);
+
+    Buffer<BVHNode> _nodes;
+    Buffer<int> _prims;
+    int _leafAlign = 1;
+};
+
+template <typename IntersectLeaf>
+bool
+BVH::intersectFrom(int node, const Ray &ray, float tmin, Hit &hit,
+                   IntersectLeaf intersectLeaf) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    const Vector3f orig = ray.getOrigin();
+    const Vector3f dir = ray.getDirection();
+    const Vector3f invDir(1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]);
+
+    float tnear, tfar;
+    if (!_nodes[node].box.intersect(orig, invDir, tmin, hit.getT(), tnear, tfar)) {
+        Stats::count(Stats::BoxTests);
+        return false;
+    }
+
+    struct Entry
+    {
+        int node;
+        float tnear;
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+
+    bool intersected = false;
+    int boxTests = 1;
+    while (true) {
+        const BVHNode &n = _nodes[node];
+        if (n.isLeaf()) {
+            if (intersectLeaf(n.offset, n.count)) {
+                intersected = true;
+            }
+        } else {
+            int a = node + 1;
+            int b = n.offset;
+            float ta, tb;
+            boxTests += 2;
+            bool hitA = _nodes[a].box.intersect(orig, invDir, tmin, hit.getT(), ta, tfar);
+            bool hitB = _nodes[b].box.intersect(orig, invDir, tmin, hit.getT(), tb, tfar);
+            if (hitA && hitB) {
+                // visit the nearer child first, keep the other for later
+                if (tb < ta) {
+                    std::swap(a, b);
+                    std::swap(ta, tb);
+                }
+                assert(sp < kStackSize);
+                stack[sp].node = b;
+                stack[sp].tnear = tb;
+                sp++;
+                node = a;
+                continue;
+            } else if (hitA) {
+                node = a;
+                continue;
+            } else if (hitB) {
+                node = b;
+                continue;
+            }
+        }
+
+        // pop the next subtree that can still contain a closer hit
+        do {
+            if (sp == 0) {
+                Stats::count(Stats::BoxTests, boxTests);
+                return intersected;
+            }
+            sp--;
+        } while (stack[sp].tnear > hit.getT());
+        node = stack[sp].node;
+    }
+}
+
+template <typename IntersectLeaf, typename IntersectLeafPacket>
+int
+BVH::intersectPacketLeaves(const RayPacket &rays, int mask, float tmin, Hit *hits,
+                           IntersectLeaf intersectLeaf,
+                           IntersectLeafPacket intersectLeafPacket) const
+{
+    if (_nodes.empty() || !mask) {
+        return 0;
+    }
+
+    struct Entry
+    {
+        int node;
+        int mask;   // lanes that reached the parent
+    };
+    Entry stack[kStackSize];
+    int sp = 0;
+    stack[sp].node = 0;
+    stack[sp].mask = mask;
+    sp++;
+
+    int updated = 0;
+    int boxTests = 0;
+    while (sp > 0) {
+        sp--;
+        int node = stack[sp].node;
+        const BVHNode &n = _nodes[node];
+        boxTests += numLanes(stack[sp].mask);
+        int m = intersectBoxPacket(n.box, rays, stack[sp].mask, tmin, hits);
+        if (!m) {
+            continue;
+        }
+
+        if (!(m & (m - 1))) {
+            // the packet diverged down to one ray: finish it on its own
+            int lane = firstLane(m);
+            const Ray ray = rays.getRay(lane);
+            Hit &hit = hits[lane];
+            auto intersectLane = [&](int first, int count) {
+                return intersectLeaf(first, count, ray, hit);
+            };
+            if (intersectFrom(node, ray, tmin, hit, intersectLane)) {
+                updated |= m;
+            }
+        } else if (n.isLeaf()) {
+            updated |= intersectLeafPacket(n.offset, n.count, m);
+        } else {
+            // front to back along the split axis for the first active ray
+            int first = node + 1;
+            int second = n.offset;
+            int lane = firstLane(m);
+            const float *dir = n.axis == 0 ? rays.dx : (n.axis == 1 ? rays.dy : rays.dz);
+            if (dir[lane] < 0) {
+                std::swap(first, second);
+            }
+            assert(sp + 2 <= kStackSize);
+            stack[sp].node = second;
+            stack[sp].mask = m;
+            sp++;
+            stack[sp].node = first;
+            stack[sp].mask = m;
+            sp++;
+        }
+    }
+    Stats::count(Stats::BoxTests, boxTests);
+    return updated;
+}
+
+inline int
+BVH::intersectBoxPacket(const Box &box, const RayPacket &rays,
+                        int mask, float tmin, const Hit *hits)
+{
+    const float *orig[3] = { rays.ox, rays.oy, rays.oz };
+    const float *inv[3] = { rays.ix, rays.iy, rays.iz };
+    float tfar[RayPacket::kSize];
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        tfar[i] = hits[i].getT();
+    }
+
+    // same steps as Box::intersect, one lane per ray
+    Float4 tn(tmin);
+    Float4 tf = Float4::load(tfar);
+    for (int dim = 0; dim < 3; dim++) {
+        Float4 o = Float4::load(orig[dim]);
+        Float4 id = Float4::load(inv[dim]);
+        Float4 t0 = (Float4(box.mn[dim]) - o) * id;
+        Float4 t1 = (Float4(box.mx[dim]) - o) * id;
+        Float4 swap = t0 > t1;
+        Float4 lo = Float4::select(swap, t1, t0);
+        Float4 hi = Float4::select(swap, t0, t1) * Float4(1.0000004f);
+        tn = Float4::select(lo > tn, lo, tn);
+        tf = Float4::select(hi < tf, hi, tf);
+    }
+    return mask & ~(tn > tf).mask();
+}
+
+template <typename OccludedLeaf>
+bool
+BVH::occludedLeaves(const Ray &ray, float tmin, float tmax,
+                    OccludedLeaf occludedLeaf) const
+{
+    if (_nodes.empty()) {
+        return false;
+    }
+
+    const Vector3f orig = ray.getOrigin();
+    const Vector3f dir = ray.getDirection();
+    const Vector3f invDir(1.0f / dir[0], 1.0f / dir[1], 1.0f / dir[2]);
+
+    // order does not matter for an any-hit query
+    int stack[kStackSize];
+    int sp = 0;
+    stack[sp++] = 0;
+    int boxTests = 0;
+    while (sp > 0) {
+        int node = stack[--sp];
+        const BVHNode &n = _nodes[node];
+        float tnear, tfar;
+        boxTests++;
+        if (!n.box.intersect(orig, invDir, tmin, tmax, tnear, tfar)) {
+            continue;
+        }
+        if (n.isLeaf()) {
+            if (occludedLeaf(n.offset, n.count)) {
+                Stats::count(Stats::BoxTests, boxTests);
+                return true;
+            }
+        } else {
+            assert(sp + 2 <= kStackSize);
+            stack[sp++] = n.offset;
+            stack[sp++] = node + 1;
+        }
+    }
+    Stats::count(Stats::BoxTests, boxTests);
+    return false;
+}
+
+#endif // BVH_H
@@ -0,0 +1,152 @@
+#include "Batch.h"
+
+#include "ArgParser.h"
+#include "AssetCache.h"
+#include "Renderer.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Splits line into whitespace separated words, "quoted" words may contain
+// spaces. Returns false if a quote is not closed.
+bool splitArgs(const std::string& line, std::vector<std::string>& words) {
+    words.clear();
+    size_t i = 0;
+    while (true) {
+        while (i < line.size() && isspace((unsigned char)line[i]))
+            i++;
+        if (i == line.size())
+            return true;
+        std::string word;
+        while (i < line.size() && !isspace((unsigned char)line[i])) {
+            if (line[i] == '"') {
+                size_t end = line.find('"', i + 1);
+                if (end == std::string::npos)
+                    return false;
+                word += line.substr(i + 1, end - i - 1);
+                i = end + 1;
+            } else {
+                word += line[i++];
+            }
+        }
+        words.push_back(word);
+    }
+}
+
+// 一个待渲染的任务
+struct Job {
+    ArgParser args;
+    int line;  // 在任务文件中的行号
+};
+
+}  // namespace
+
+int runBatch(int argc, const char* argv[], const ArgParser& args) {
+    std::ifstream in(args.jobs_file.c_str());
+    if (!in) {
+        std::cerr << "Cannot open job file " << args.jobs_file << std::endl;
+        return 1;
+    }
+
+    // 命令行中除 -jobs 以外的参数是每个任务的默认值
+    std::vector<std::string> defaults;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-jobs"))
+            i++;
+        else
+            defaults.push_back(argv[i]);
+    }
+
+    std::vector<Job> jobs;
+    bool stats = args.stats != 0;
+    std::string line;
+    std::vector<std::string> words;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        if (!splitArgs(line, words)) {
+            std::cerr << args.jobs_file << ":" << lineNumber << ": unterminated quote" << std::endl;
+            return 1;
+        }
+        if (words.empty() || words[0][0] == '#')
+            continue;
+
+        std::vector<const char*> jobArgv(1, argv[0]);
+        for (const std::string& word : defaults)
+            jobArgv.push_back(word.c_str());
+        for (const std::string& word : words)
+            jobArgv.push_back(word.c_str());
+        jobs.push_back({ArgParser((int)jobArgv.size(), jobArgv.data()), lineNumber});
+
+        ArgParser& job = jobs.back().args;
+        if (job.input_file.empty() || !job.jobs_file.empty()) {
+            std::cerr << args.jobs_file << ":" << lineNumber
+                      << (job.input_file.empty() ? ": no -input" : ": nested -jobs") << std::endl;
+            return 1;
+        }
+        // 统计对整批任务只报告一次
+        stats = stats || job.stats;
+        job.stats = 0;
+    }
+    if (jobs.empty()) {
+        std::cerr << "No jobs in " << args.jobs_file << std::endl;
+        return 1;
+    }
+
+    AssetCache assets;
+    ThreadPool pool(args.threads);
+    std::cout << "Rendering " << jobs.size() << " jobs on " << pool.getNumThreads()
+              << " threads" << std::endl;
+    auto start = std::chrono::steady_clock::now();
+    std::mutex logMutex;
+    int done = 0;
+    int failed = 0;
+    TaskGroup group;
+    for (size_t j = 0; j < jobs.size(); j++) {
+        pool.submit(group, [&, j]() {
+            const Job& job = jobs[j];
+            auto jobStart = std::chrono::steady_clock::now();
+            // 一个任务的场景出错只让该任务失败, 其他任务照常完成
+            try {
+                Renderer renderer(job.args, &assets, &pool);
+                renderer.Render();
+            } catch (const std::exception& e) {
+                std::lock_guard<std::mutex> lock(logMutex);
+                done++;
+                failed++;
+                std::cerr << "Failed job " << done << " of " << jobs.size() << " (line "
+                          << job.line << ", " << job.args.output_file << "): " << e.what()
+                          << std::endl;
+                return;
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - jobStart;
+            std::lock_guard<std::mutex> lock(logMutex);
+            done++;
+            std::cout << "Finished job " << done << " of " << jobs.size() << " (line "
+                      << job.line << ", " << job.args.output_file << ") in " << elapsed.count()
+                      << " s" << std::endl;
+        });
+    }
+    {
+        Stats::Timer timer(Stats::Render);
+        pool.wait(group);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Rendered " << jobs.size() - failed << " jobs in " << elapsed.count() << " s"
+              << std::endl;
+    if (failed)
+        std::cerr << failed << " of " << jobs.size() << " jobs failed" << std::endl;
+    if (stats)
+        Stats::report(std::cout);
+    return failed ? 1 : 0;
+}
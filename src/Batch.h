@@ -0,0 +1,31 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+class ArgParser;
+
+// -jobs <file>: renders many scenes and frames in one process.
+//
+// Every line of the file is one job, written as a2 arguments. Empty lines
+// and lines starting with '#' are skipped, and "quoted arguments" may
+// contain spaces. The other command line arguments come before those of
+// each job, so they are defaults that a job can override:
+//
+//     a2 -jobs nightly.txt -size 1080 1080 -threads 0
+//
+// All jobs are parsed before the first one starts. They then render
+// concurrently on one pool of -threads threads, and their scenes share
+// meshes, acceleration structures and cube maps through one AssetCache;
+// every job writes the same images as a separate run. A thread waiting
+// inside a job only helps with that job's work, so jobs never nest on one
+// stack. -stats on the command line or in any job prints one report for
+// the whole batch: the phase times are those of the main thread, which
+// waits for and helps with the jobs, and the phases of the jobs run by
+// the pool threads are summed on their own line.
+//
+// A job whose scene or meshes cannot be loaded is reported and the other
+// jobs still finish; the batch then exits with 1.
+//
+// args is the parsed command line; returns the exit code of the process.
+int runBatch(int argc, const char *argv[], const ArgParser &args);
+
+#endif  // BATCH_H
@@ -0,0 +1,87 @@
+#ifndef BOX_H
+#define BOX_H
+
+#include "Vector3f.h"
+
+#include <algorithm>
+#include <limits>
+
+// Axis aligned bounding box
+struct Box
+{
+    Vector3f mn, mx;
+
+    Box() {}
+
+    Box(const Vector3f &a, const Vector3f &b) :
+        mn(a),
+        mx(b)
+    {}
+
+    Box(float mnx, float mny, float mnz,
+        float mxx, float mxy, float mxz) :
+        mn(Vector3f(mnx, mny, mnz)),
+        mx(Vector3f(mxx, mxy, mxz))
+    {}
+
+    ///@brief box that contains nothing, ready to be extended
+    static Box empty() {
+        const float inf = std::numeric_limits<float>::infinity();
+        return Box(inf, inf, inf, -inf, -inf, -inf);
+    }
+
+    void extend(const Vector3f &p) {
+        for (int dim = 0; dim < 3; dim++) {
+            mn[dim] = std::min(mn[dim], p[dim]);
+            mx[dim] = std::max(mx[dim], p[dim]);
+        }
+    }
+
+    void extend(const Box &b) {
+        for (int dim = 0; dim < 3; dim++) {
+            mn[dim] = std::min(mn[dim], b.mn[dim]);
+            mx[dim] = std::max(mx[dim], b.mx[dim]);
+        }
+    }
+
+    Vector3f centroid() const {
+        return (mn + mx) * 0.5f;
+    }
+
+    ///@brief surface area, 0 for an empty box
+    float area() const {
+        Vector3f d = mx - mn;
+        if (d[0] < 0 || d[1] < 0 || d[2] < 0) {
+            return 0;
+        }
+        return 2 * (d[0] * d[1] + d[1] * d[2] + d[2] * d[0]);
+    }
+
+    ///@brief slab test against a ray given by origin and inverse direction.
+    /// On a hit [tnear, tfar] is the overlap of the box with [tmin, tmax].
+    bool intersect(const Vector3f &orig, const Vector3f &invDir,
+                   float tmin, float tmax,
+                   float &tnear, float &tfar) const
+    {
+        for (int dim = 0; dim < 3; dim++) {
+            float t0 = (mn[dim] - orig[dim]) * invDir[dim];
+            float t1 = (mx[dim] - orig[dim]) * invDir[dim];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            // widen slightly so rounding never culls a box the ray touches
+            t1 *= 1.0000004f;
+            // NaN (0 * inf) leaves the interval untouched
+            tmin = t0 > tmin ? t0 : tmin;
+            tmax = t1 < tmax ? t1 : tmax;
+            if (tmin > tmax) {
+                return false;
+            }
+        }
+        tnear = tmin;
+        tfar = tmax;
+        return true;
+    }
+};
+
+#endif // BOX_H
@@ -0,0 +1,94 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Read-only array that either owns its elements or refers to memory
+// owned by someone else, such as a mapped cache file. Readers see the
+// same data() / size() / operator[] either way.
+template <typename T>
+class Buffer
+{
+  public:
+    Buffer() : _data(nullptr), _size(0) {}
+
+    Buffer(const Buffer &other) : _owned(other._owned)
+    {
+        point(other);
+    }
+
+    Buffer(Buffer &&other) : _owned(std::move(other._owned))
+    {
+        point(other);
+        other.reset();
+    }
+
+    Buffer &operator=(const Buffer &other)
+    {
+        if (this != &other) {
+            _owned = other._owned;
+            point(other);
+        }
+        return *this;
+    }
+
+    Buffer &operator=(Buffer &&other)
+    {
+        if (this != &other) {
+            _owned = std::move(other._owned);
+            point(other);
+            other.reset();
+        }
+        return *this;
+    }
+
+    // takes over the elements of v
+    void assign(std::vector<T> &&v)
+    {
+        _owned = std::move(v);
+        _data = _owned.data();
+        _size = _owned.size();
+    }
+
+    // refers to [data, data + size) without copying; the memory must
+    // outlive the buffer
+    void view(const T *data, size_t size)
+    {
+        std::vector<T>().swap(_owned);
+        _data = data;
+        _size = size;
+    }
+
+    void reset()
+    {
+        std::vector<T>().swap(_owned);
+        _data = nullptr;
+        _size = 0;
+    }
+
+    const T *data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    // the elements live outside of the buffer
+    bool isView() const { return _data && _owned.empty(); }
+
+    const T &operator[](size_t i) const { return _data[i]; }
+    const T *begin() const { return _data; }
+    const T *end() const { return _data + _size; }
+
+  private:
+    // after _owned was copied or moved from other
+    void point(const Buffer &other)
+    {
+        _data = other._owned.empty() && other._data ? other._data : _owned.data();
+        _size = other._size;
+    }
+
+    std::vector<T> _owned;  // 自有元素, 引用外部内存时为空
+    const T *_data;
+    size_t _size;
+};
+
+#endif // BUFFER_H
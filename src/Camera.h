@@ -13,7 +13,7 @@ public:
     virtual ~Camera() {}
 
     // Generate rays for each screen-space coordinate
-    virtual Ray generateRay(const Vector2f &point) = 0;
+    virtual Ray generateRay(const Vector2f &point) const = 0;
     virtual float getTMin() const = 0;
 };
 
@@ -33,7 +33,7 @@ public:
         _horizontal = Vector3f::cross(direction, up).normalized();
     }
 
-    virtual Ray generateRay(const Vector2f &point) override
+    virtual Ray generateRay(const Vector2f &point) const override
     {
         // 输入坐标 x[-1,1] y[-1,1]
         // BEGIN STARTER
@@ -0,0 +1,90 @@
+#include "Checkpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'A', '2', 'C', 'K', 'P', 'T', 0, 0};
+// reads back differently on a machine of the other byte order
+const uint32_t kByteOrder = 0x01020304;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int32_t width;
+    int32_t height;
+    int32_t passes;        // 已累加的遍数
+    uint32_t settingsSize; // 其后设置字符串的字节数
+};
+
+}  // namespace
+
+bool Checkpoint::load(const std::string& path, const std::string& settings, int width,
+                      int height, int& passes, std::vector<Vector3f>& sums) {
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in.is_open())
+        return false;
+    Header h;
+    if (!in.read((char*)&h, sizeof(h)))
+        return false;
+    if (memcmp(h.magic, kMagic, sizeof(kMagic)) || h.version != kVersion ||
+        h.byteOrder != kByteOrder || h.width != width || h.height != height || h.passes < 0 ||
+        h.settingsSize != settings.size())
+        return false;
+    std::string stored(settings.size(), '\0');
+    if (!in.read(&stored[0], stored.size()) || stored != settings)
+        return false;
+
+    std::vector<Vector3f> data((size_t)width * height);
+    if (!in.read((char*)data.data(), data.size() * sizeof(Vector3f)))
+        return false;
+    passes = h.passes;
+    sums.swap(data);
+    return true;
+}
+
+bool Checkpoint::save(const std::string& path, const std::string& settings, int width,
+                      int height, int passes, const std::vector<Vector3f>& sums) {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.byteOrder = kByteOrder;
+    h.width = width;
+    h.height = height;
+    h.passes = passes;
+    h.settingsSize = (uint32_t)settings.size();
+
+    std::ostringstream tmpName;
+    tmpName << path << ".tmp";
+#if defined(__unix__) || defined(__APPLE__)
+    tmpName << getpid();
+#endif
+    const std::string tmp = tmpName.str();
+    {
+        std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+        out.write((const char*)&h, sizeof(h));
+        out.write(settings.data(), settings.size());
+        out.write((const char*)sums.data(), sums.size() * sizeof(Vector3f));
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
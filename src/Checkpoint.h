@@ -0,0 +1,34 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vecmath.h"
+
+// Accumulation buffer of a progressive render, saved between passes so a
+// render that is stopped can resume where it left off.
+//
+// The file is a fixed header, the settings string the render was started
+// with, and the per-pixel colour sums row by row. A checkpoint only
+// belongs to a render with the same size and settings.
+class Checkpoint
+{
+  public:
+    // bump whenever the layout of the file changes
+    static const uint32_t kVersion = 1;
+
+    // Reads the checkpoint at path into passes and sums. Returns false if
+    // it is missing, damaged or was written for another size or settings.
+    static bool load(const std::string &path, const std::string &settings, int width,
+                     int height, int &passes, std::vector<Vector3f> &sums);
+
+    // Writes the checkpoint through a temporary file that is renamed into
+    // place, so an interrupted write keeps the previous one. Returns false
+    // if it cannot be written.
+    static bool save(const std::string &path, const std::string &settings, int width,
+                     int height, int passes, const std::vector<Vector3f> &sums);
+};
+
+#endif  // CHECKPOINT_H
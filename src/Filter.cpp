@@ -0,0 +1,90 @@
+#include "Filter.h"
+
+#include <cmath>
+
+namespace {
+
+const float kGaussianSigma = 0.5f;
+
+float radiusOf(Filter::Kernel kernel) {
+    switch (kernel) {
+    case Filter::Box:
+        return 0.5f;
+    case Filter::Tent:
+        return 1.0f;
+    case Filter::Gaussian:
+        return 1.5f;
+    case Filter::Mitchell:
+        return 2.0f;
+    }
+    return 0.5f;
+}
+
+float gaussian(float d) {
+    return std::exp(-d * d / (2 * kGaussianSigma * kGaussianSigma));
+}
+
+// Mitchell-Netravali cubic on [0, 2]
+float mitchell(float x) {
+    const float B = 1.0f / 3, C = 1.0f / 3;
+    if (x < 1)
+        return ((12 - 9 * B - 6 * C) * x * x * x + (-18 + 12 * B + 6 * C) * x * x +
+                (6 - 2 * B)) / 6;
+    if (x < 2)
+        return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x + (-12 * B - 48 * C) * x +
+                (8 * B + 24 * C)) / 6;
+    return 0;
+}
+
+}  // namespace
+
+Filter::Filter(Kernel kernel) : _kernel(kernel), _radius(radiusOf(kernel)) {}
+
+bool Filter::parseKernel(const std::string& name, Kernel& kernel) {
+    if (name == "box")
+        kernel = Box;
+    else if (name == "tent")
+        kernel = Tent;
+    else if (name == "gaussian")
+        kernel = Gaussian;
+    else if (name == "mitchell")
+        kernel = Mitchell;
+    else
+        return false;
+    return true;
+}
+
+float Filter::weight(float d) const {
+    d = std::fabs(d);
+    if (d >= _radius)
+        return 0;
+    switch (_kernel) {
+    case Box:
+        return 1;
+    case Tent:
+        return 1 - d;
+    case Gaussian:
+        // shifted so the kernel reaches 0 at the radius
+        return gaussian(d) - gaussian(_radius);
+    case Mitchell:
+        return mitchell(2 * d / _radius);
+    }
+    return 0;
+}
+
+void Filter::taps(int scale, int& first, std::vector<float>& weights) const {
+    weights.clear();
+    // subsample scale * x + o is centred (o + 0.5) / scale - 0.5 pixels
+    // from the centre of pixel x
+    const int reach = (int)std::ceil(_radius * scale) + scale;
+    first = 0;
+    for (int o = -reach; o <= reach; o++) {
+        float w = weight((o + 0.5f) / scale - 0.5f);
+        if (w == 0)
+            continue;
+        if (weights.empty())
+            first = o;
+        weights.resize(o - first + 1, 0.0f);
+        weights.back() = w;
+    }
+}
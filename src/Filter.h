@@ -0,0 +1,39 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <string>
+#include <vector>
+
+// Separable reconstruction filter that turns scale x scale subsamples per
+// pixel into the output image. The 1D kernel is a function of the distance
+// to the output pixel centre, measured in output pixels; the 2D weight of
+// a subsample is the product of the kernels of its x and y distances.
+class Filter {
+  public:
+    enum Kernel {
+        Box,       // 像素内各子采样等权
+        Tent,      // 半径 1 像素的三角形
+        Gaussian,  // sigma 0.5 像素, 截断于 1.5 像素
+        Mitchell,  // Mitchell-Netravali, B = C = 1/3, 半径 2 像素
+    };
+
+    explicit Filter(Kernel kernel = Gaussian);
+
+    // "box" / "tent" / "gaussian" / "mitchell", returns false for unknown names
+    static bool parseKernel(const std::string &name, Kernel &kernel);
+
+    // weight at distance d (in output pixels) from the pixel centre
+    float weight(float d) const;
+    float getRadius() const { return _radius; }
+
+    // Taps along one axis with scale subsamples per pixel: subsample
+    // scale * x + first + i gets weights[i] for output pixel x. Weights may
+    // be negative (Mitchell) and are not normalized.
+    void taps(int scale, int &first, std::vector<float> &weights) const;
+
+  private:
+    Kernel _kernel;
+    float _radius; // 滤波核半径, 以输出像素计
+};
+
+#endif  // FILTER_H
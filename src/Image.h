@@ -7,6 +7,16 @@
 
 #include "vecmath.h"
 
+class ThreadPool;
+
+// Difference between two images over all pixels and channels
+struct ImageError
+{
+    double rmse;     // 均方根误差
+    double psnr;     // 峰值信噪比 (dB), 峰值取 1; 两图相同时为无穷大
+    float maxError;  // 单个通道的最大绝对误差
+};
+
 // Simple image class
 class Image
 {
@@ -61,6 +71,11 @@ public:
     // Return an absolute difference betweenthe given images
     static Image compare(const Image & img1, const Image & img2);
 
+    // Measures how far img1 is from img2 and, if diff is given, stores the
+    // absolute difference in it. Rows are split over pool when one is given.
+    static ImageError compare(const Image & img1, const Image & img2, Image *diff,
+                              ThreadPool *pool = nullptr);
+
 private:
     int _width;
     int _height;
@@ -18,7 +18,8 @@ void PointLight::getIllumination(const Vector3f& p,    // 交点位置
                                  Vector3f& intensity,  // 光源强度
                                  float& distToLight    // 交点到光源的距离
 ) const {
-    tolight = (_position - p).normalized();
+    tolight = _position - p;
     distToLight = tolight.abs();
+    tolight = tolight / distToLight;
     intensity = _color / (_falloff * distToLight * distToLight);
 }
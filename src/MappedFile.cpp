@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define A2_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string& filename) {
+    close();
+#ifdef A2_HAVE_MMAP
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::close(fd);
+            _data = (const char*)p;
+            _size = (size_t)st.st_size;
+            _mapped = true;
+            return true;
+        }
+    }
+    ::close(fd);
+#endif
+    // 无法映射 (或空文件): 读入内存
+    std::ifstream f(filename.c_str(), std::ios::binary);
+    if (!f.is_open())
+        return false;
+    _buffer.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    _data = _buffer.data();
+    _size = _buffer.size();
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef A2_HAVE_MMAP
+    if (_mapped)
+        munmap((void*)_data, _size);
+#endif
+    _buffer.clear();
+    _data = nullptr;
+    _size = 0;
+    _mapped = false;
+}
@@ -0,0 +1,33 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file.
+// Memory-mapped where the platform supports it, read into a buffer
+// otherwise; either way data() stays valid until the object dies.
+class MappedFile {
+   public:
+    MappedFile() : _data(nullptr), _size(0), _mapped(false) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // returns false if the file cannot be opened
+    bool open(const std::string& filename);
+    void close();
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+   private:
+    const char* _data;
+    size_t _size;
+    bool _mapped;              // _data 指向映射内存而非 _buffer
+    std::vector<char> _buffer;  // 无法映射时的文件内容
+};
+
+#endif  // MAPPED_FILE_H
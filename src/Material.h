@@ -36,7 +36,7 @@ class Material
     Vector3f shade(const Ray &ray,
         const Hit &hit,
         const Vector3f &dirToLight,
-        const Vector3f &lightIntensity);
+        const Vector3f &lightIntensity) const;
 
 protected:
 
@@ -0,0 +1,18 @@
+#include "MemoryUsage.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+size_t peakResidentBytes() {
+#if defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (size_t)usage.ru_maxrss;  // bytes on macOS
+#elif defined(__unix__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+        return (size_t)usage.ru_maxrss * 1024;  // KiB on Linux
+#endif
+    return 0;
+}
@@ -0,0 +1,9 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <cstddef>
+
+// Peak resident set size of the process in bytes, 0 where unsupported
+size_t peakResidentBytes();
+
+#endif  // MEMORY_USAGE_H
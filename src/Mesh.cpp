@@ -1,13 +1,21 @@
 #include "Mesh.h"
+#include "MemoryUsage.h"
+#include "MeshCache.h"
+#include "ObjLoader.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
 #include <fstream>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <utility>
 #include <sstream>
+#include <stdexcept>
 
 #include <map>
+#include <memory>
 #include <set>
 
 struct Edge {
@@ -84,70 +92,44 @@ void subdivideMesh(std::vector<Vector3f>& vertices, std::vector<ObjTriangle>& tr
     triangles = newTriangles;
 }
 
-Mesh::Mesh(const std::string& filename, Material* material) : Object3D(material) {
-    std::ifstream f;
-    f.open(filename.c_str());
-    if (!f.is_open()) {
-        std::cout << "Cannot open " << filename << "\n";
-        return;
+Mesh::Mesh(const std::string& filename, Material* material, AccelType accel,
+           const MeshOptions& options)
+    : Object3D(material), _accel(accel) {
+    std::string cachePath;
+    if (options.cache) {
+        auto cacheStart = std::chrono::steady_clock::now();
+        cachePath = MeshCache::path(filename, options.cacheDir, accelTypeName(_accel));
+        if (loadCache(filename, cachePath)) {
+            std::chrono::duration<double, std::milli> cacheTime =
+                std::chrono::steady_clock::now() - cacheStart;
+            std::cout << "Loaded " << filename << " from " << cachePath << ": "
+                      << _positions.size() << " vertices, " << getNumTriangles()
+                      << " triangles, " << cacheTime.count() << " ms, peak RSS "
+                      << peakResidentBytes() / (1024 * 1024) << " MiB" << std::endl;
+            return;
+        }
     }
 
-    std::vector<Vector3f> v;         // 顶点数组
-    std::vector<ObjTriangle> t;      // 三角形数组
-    std::vector<Vector3f> n;         // 法向量数组
-    std::vector<Vector2f> texCoord;  // 纹理坐标数组
-
-    const std::string vTok("v");     // 顶点标记
-    const std::string fTok("f");     // 面标记
-    const std::string texTok("vt");  // 纹理标记
-    const char bslash = '/', space = ' ';
-    std::string tok;
-    std::string line;
-    while (true) {
-        std::getline(f, line);
-        if (f.eof()) {
-            break;
-        }
-        if (line.size() < 3) {
-            continue;
-        }
-        if (line.at(0) == '#') {
-            continue;
-        }
-        std::stringstream ss(line);
-        ss >> tok;
-        if (tok == vTok) {  // 添加顶点
-            Vector3f vec;
-            ss >> vec[0] >> vec[1] >> vec[2];
-            v.push_back(vec);
-        } else if (tok == fTok) {                          // 添加三角形
-            if (line.find(bslash) != std::string::npos) {  // 如果有纹理
-                std::replace(line.begin(), line.end(), bslash, space);
-                std::stringstream facess(line);  // f 5/1 1/2 4/3
-                ObjTriangle trig;
-                facess >> tok;
-                for (int ii = 0; ii < 3; ii++) {
-                    facess >> trig[ii] >> trig.texID[ii];
-                    trig[ii]--;
-                    trig.texID[ii]--;
-                }
-                t.push_back(trig);
-            } else {  // 没有纹理
-                ObjTriangle trig;
-                for (int ii = 0; ii < 3; ii++) {
-                    ss >> trig[ii];
-                    trig[ii]--;
-                    trig.texID[ii] = 0;
-                }
-                t.push_back(trig);
-            }
-        } else if (tok == texTok) {  // 添加纹理坐标
-            Vector2f texcoord;
-            ss >> texcoord[0] >> texcoord[1];
-            texCoord.push_back(texcoord);
-        }
+    // 没有传入线程池时为本次加载创建一个
+    std::unique_ptr<ThreadPool> ownPool;
+    if (!options.pool)
+        ownPool.reset(new ThreadPool(options.threads));
+    ThreadPool& pool = options.pool ? *options.pool : *ownPool;
+
+    auto loadStart = std::chrono::steady_clock::now();
+    ObjMesh obj;
+    if (!loadObj(filename, obj, pool)) {
+        throw std::runtime_error("Cannot open " + filename);
     }
-    f.close();
+    std::chrono::duration<double, std::milli> loadTime =
+        std::chrono::steady_clock::now() - loadStart;
+    std::cout << "Loaded " << filename << ": " << obj.positions.size() << " vertices, "
+              << obj.triangles.size() << " triangles, " << loadTime.count() << " ms, peak RSS "
+              << peakResidentBytes() / (1024 * 1024) << " MiB" << std::endl;
+
+    std::vector<Vector3f>& v = obj.positions;     // 顶点数组
+    std::vector<ObjTriangle>& t = obj.triangles;  // 三角形数组
+    std::vector<Vector3f> n;                      // 法向量数组
 
     // LOOP曲面细分器
     // subdivideMesh(v, t);
@@ -177,25 +159,202 @@ Mesh::Mesh(const std::string& filename, Material* material) : Object3D(material)
         n[ii] = n[ii] / n[ii].abs();  // 归一化
     }
 
-    // Set up triangles
-    for (int i = 0; i < t.size(); i++) {
-        Triangle triangle(v[t[i][0]], v[t[i][1]], v[t[i][2]], n[t[i][0]], n[t[i][1]],
-                          n[t[i][2]], getMaterial());
-        _triangles.push_back(triangle);
+    // Set up index buffers
+    // 文件中给出 vn 的角点使用该法向量, 否则使用平滑法向量
+    const uint32_t numVertices = (uint32_t)v.size();
+    bool fileNormals = false;
+    std::vector<uint32_t> indices(3 * t.size());
+    std::vector<uint32_t> normalIndices(3 * t.size());
+    for (size_t i = 0; i < t.size(); i++) {
+        for (int jj = 0; jj < 3; jj++) {
+            indices[3 * i + jj] = (uint32_t)t[i][jj];
+            normalIndices[3 * i + jj] =
+                t[i].normalID[jj] >= 0 ? numVertices + t[i].normalID[jj] : t[i][jj];
+            fileNormals = fileNormals || t[i].normalID[jj] >= 0;
+        }
     }
+    if (!fileNormals)
+        std::vector<uint32_t>().swap(normalIndices);
+    n.insert(n.end(), obj.normals.begin(), obj.normals.end());
+
+    _bounds = Box::empty();
+    for (const Vector3f& p : v)
+        _bounds.extend(p);
+
+    _positions.assign(std::move(v));
+    _normals.assign(std::move(n));
+    _indices.assign(std::move(indices));
+    _normalIndices.assign(std::move(normalIndices));
+    obj = ObjMesh();
+
+    std::vector<Vector3f> shadingNormals(getNumTriangles());
+    for (int i = 0; i < getNumTriangles(); i++)
+        shadingNormals[i] = (cornerNormal(i, 0) + cornerNormal(i, 1) + cornerNormal(i, 2)).normalized();
+    _shadingNormals.assign(std::move(shadingNormals));
+
+    buildAccel(filename, pool);
+    if (options.cache)
+        writeCache(filename, cachePath);
+}
 
-    octree.build(this);
+Mesh::Mesh(const std::shared_ptr<const Mesh>& mesh, Material* material)
+    : Object3D(material), _bounds(mesh->_bounds), _accel(mesh->_accel), _shared(mesh) {
+    _positions.view(mesh->_positions.data(), mesh->_positions.size());
+    _normals.view(mesh->_normals.data(), mesh->_normals.size());
+    _indices.view(mesh->_indices.data(), mesh->_indices.size());
+    _normalIndices.view(mesh->_normalIndices.data(), mesh->_normalIndices.size());
+    _shadingNormals.view(mesh->_shadingNormals.data(), mesh->_shadingNormals.size());
+    _blocks.view(mesh->_blocks.data(), mesh->_blocks.size());
+    const BVH& b = mesh->bvh;
+    if (!b.empty())
+        bvh.view(b.getNodes().data(), b.getNodes().size(), b.getPrimitives().data(),
+                 b.getPrimitives().size(), b.getLeafAlign());
+    const Octree& o = mesh->octree;
+    octree.view(o.getBounds(), o.getNodes().data(), o.getNodes().size(), o.getBlocks().data(),
+                o.getBlocks().size());
+}
+
+bool Mesh::loadCache(const std::string& filename, const std::string& cachePath) {
+    Stats::Timer timer(Stats::MeshLoad);
+    if (!_cache.open(cachePath, filename, accelTypeName(_accel)))
+        return false;
+
+    size_t numPositions, numNormals, numIndices, numNormalIndices, numShading;
+    size_t numBlocks, numNodes, numPrims, numOctBounds, numOctNodes, numOctBlocks;
+    const Vector3f* positions = _cache.get<Vector3f>(MeshCache::Positions, numPositions);
+    const Vector3f* normals = _cache.get<Vector3f>(MeshCache::Normals, numNormals);
+    const uint32_t* indices = _cache.get<uint32_t>(MeshCache::Indices, numIndices);
+    const uint32_t* normalIndices =
+        _cache.get<uint32_t>(MeshCache::NormalIndices, numNormalIndices);
+    const Vector3f* shading = _cache.get<Vector3f>(MeshCache::ShadingNormals, numShading);
+    const TriangleBlock* blocks = _cache.get<TriangleBlock>(MeshCache::Blocks, numBlocks);
+    const BVHNode* nodes = _cache.get<BVHNode>(MeshCache::BVHNodes, numNodes);
+    const int* prims = _cache.get<int>(MeshCache::BVHPrims, numPrims);
+    const Box* octBounds = _cache.get<Box>(MeshCache::OctreeBounds, numOctBounds);
+    const OctNode* octNodes = _cache.get<OctNode>(MeshCache::OctreeNodes, numOctNodes);
+    const TriangleBlock* octBlocks =
+        _cache.get<TriangleBlock>(MeshCache::OctreeBlocks, numOctBlocks);
+
+    // 缓存与本程序的布局不符时重新构建
+    bool valid = positions && indices && numIndices % 3 == 0 && numShading == numIndices / 3 &&
+                 (!normalIndices || numNormalIndices == numIndices);
+    if (_accel == AccelType::BVH)
+        valid = valid && nodes && _cache.getLeafAlign() == TriangleBlock::kSize &&
+                numPrims == numBlocks * TriangleBlock::kSize;
+    else
+        valid = valid && numOctBounds == 1 && octNodes;
+    if (!valid) {
+        _cache.close();
+        return false;
+    }
+
+    _positions.view(positions, numPositions);
+    _normals.view(normals, numNormals);
+    _indices.view(indices, numIndices);
+    _normalIndices.view(normalIndices, numNormalIndices);
+    _shadingNormals.view(shading, numShading);
+    _blocks.view(blocks, numBlocks);
+    if (_accel == AccelType::BVH)
+        bvh.view(nodes, numNodes, prims, numPrims, _cache.getLeafAlign());
+    else
+        octree.view(*octBounds, octNodes, numOctNodes, octBlocks, numOctBlocks);
+    _bounds = _cache.getBounds();
+    return true;
+}
+
+void Mesh::writeCache(const std::string& filename, const std::string& cachePath) const {
+    MeshCache::Contents contents;
+    contents.bounds = _bounds;
+    contents.leafAlign = TriangleBlock::kSize;
+    contents.set(MeshCache::Positions, _positions.data(), _positions.size());
+    contents.set(MeshCache::Normals, _normals.data(), _normals.size());
+    contents.set(MeshCache::Indices, _indices.data(), _indices.size());
+    contents.set(MeshCache::NormalIndices, _normalIndices.data(), _normalIndices.size());
+    contents.set(MeshCache::ShadingNormals, _shadingNormals.data(), _shadingNormals.size());
+    contents.set(MeshCache::Blocks, _blocks.data(), _blocks.size());
+    contents.set(MeshCache::BVHNodes, bvh.getNodes().data(), bvh.getNodes().size());
+    contents.set(MeshCache::BVHPrims, bvh.getPrimitives().data(), bvh.getPrimitives().size());
+    if (_accel == AccelType::Octree) {
+        contents.set(MeshCache::OctreeBounds, &octree.getBounds(), 1);
+        contents.set(MeshCache::OctreeNodes, octree.getNodes().data(), octree.getNodes().size());
+        contents.set(MeshCache::OctreeBlocks, octree.getBlocks().data(),
+                     octree.getBlocks().size());
+    }
+    if (!MeshCache::writeFile(cachePath, filename, accelTypeName(_accel), contents))
+        std::cerr << "Warning: cannot write mesh cache " << cachePath << std::endl;
+}
+
+// 构建加速结构并报告耗时
+void Mesh::buildAccel(const std::string& filename, ThreadPool& pool) {
+    Stats::Timer timer(Stats::AccelBuild);
+    auto start = std::chrono::steady_clock::now();
+    size_t numNodes = 0;
+    if (_accel == AccelType::BVH) {
+        std::vector<Box> bounds(getNumTriangles());
+        for (size_t i = 0; i < bounds.size(); i++) {
+            bounds[i] = Box::empty();
+            for (int j = 0; j < 3; j++)
+                bounds[i].extend(getVertex((int)i, j));
+        }
+        // 叶节点按块对齐, 第 i 个图元位于块 i / kSize 的通道 i % kSize
+        bvh.build(bounds, TriangleBlock::kSize, &pool);
+        numNodes = bvh.getNodes().size();
+        const Buffer<int>& prims = bvh.getPrimitives();
+        std::vector<TriangleBlock> blocks(prims.size() / TriangleBlock::kSize);
+        for (size_t i = 0; i < prims.size(); i++) {
+            if (prims[i] >= 0) {
+                blocks[i / TriangleBlock::kSize].set(i % TriangleBlock::kSize, prims[i],
+                                                     getVertex(prims[i], 0),
+                                                     getVertex(prims[i], 1),
+                                                     getVertex(prims[i], 2));
+            }
+        }
+        _blocks.assign(std::move(blocks));
+    } else {
+        octree.build(*this, &pool);
+        numNodes = octree.getNodes().size();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Built " << accelTypeName(_accel) << " for " << filename << ": "
+              << getNumTriangles() << " triangles";
+    if (numNodes)
+        std::cout << ", " << numNodes << " nodes";
+    std::cout << ", " << elapsed.count() << " ms on " << pool.getNumThreads() << " threads"
+              << std::endl;
+}
+
+bool Mesh::parseAccelType(const std::string& name, AccelType& accel) {
+    if (name == "octree")
+        accel = AccelType::Octree;
+    else if (name == "bvh")
+        accel = AccelType::BVH;
+    else
+        return false;
+    return true;
+}
+
+const char* Mesh::accelTypeName(AccelType accel) {
+    return accel == AccelType::BVH ? "bvh" : "octree";
 }
 
 bool Mesh::intersect(const Ray& r, float tmin, Hit& h) const {
 #if 1
-    ray = &r;
-    hit = &h;
-    tm = tmin;
-    return octree.intersect(r);
+    if (_accel == AccelType::BVH) {
+        int tested = 0;  // 测试过的三角形块数, 最后一并计入统计
+        bool result = bvh.intersectLeaves(r, tmin, h, [&](int first, int count) {
+            tested += TriangleBlock::numBlocks(count);
+            return intersectBlocks(leafBlocks(first), TriangleBlock::numBlocks(count), r, tmin, h);
+        });
+        Stats::count(Stats::TriangleTests, tested * TriangleBlock::kSize);
+        return result;
+    }
+    TraversalContext ctx(*this, r, tmin, h);
+    return octree.intersect(ctx);
 #else
     bool result = false;
-    for (Triangle t : _triangles) {
+    for (int i = 0; i < getNumTriangles(); i++) {
+        Triangle t(getVertex(i, 0), getVertex(i, 1), getVertex(i, 2), cornerNormal(i, 0),
+                   cornerNormal(i, 1), cornerNormal(i, 2), getMaterial());
         if (t.intersect(r, tmin, h)) {
             result = true;
         }
@@ -204,8 +363,116 @@ bool Mesh::intersect(const Ray& r, float tmin, Hit& h) const {
 #endif
 }
 
-bool Mesh::intersectTrig(int idx, const Ray& r) const {
-    const Triangle& triangle = _triangles[idx];
-    bool result = triangle.intersect(r, tm, *hit);
+bool Mesh::occluded(const Ray& r, float tmin, float tmax) const {
+    if (_accel == AccelType::BVH) {
+        int tested = 0;
+        bool result = bvh.occludedLeaves(r, tmin, tmax, [&](int first, int count) {
+            tested += TriangleBlock::numBlocks(count);
+            return occludedBlocks(leafBlocks(first), TriangleBlock::numBlocks(count), r, tmin, tmax);
+        });
+        Stats::count(Stats::TriangleTests, tested * TriangleBlock::kSize);
+        return result;
+    }
+    Hit h;
+    h.t = tmax;
+    TraversalContext ctx(*this, r, tmin, h);
+    return octree.occluded(ctx);
+}
+
+int Mesh::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    if (_accel != AccelType::BVH)
+        return Object3D::intersectPacket(rays, mask, tmin, hits);
+    int tested = 0;  // 三角形块与光线的测试数
+    int updated = bvh.intersectPacketLeaves(
+        rays, mask, tmin, hits,
+        [&](int first, int count, const Ray& r, Hit& h) {
+            tested += TriangleBlock::numBlocks(count);
+            return intersectBlocks(leafBlocks(first), TriangleBlock::numBlocks(count), r, tmin, h);
+        },
+        [&](int first, int count, int lanes) {
+            tested += TriangleBlock::numBlocks(count) * numLanes(lanes);
+            return intersectBlocksPacket(leafBlocks(first), TriangleBlock::numBlocks(count), rays,
+                                         lanes, tmin, hits);
+        });
+    Stats::count(Stats::TriangleTests, tested * TriangleBlock::kSize);
+    return updated;
+}
+
+bool Mesh::getBounds(Box& box) const {
+    if (_indices.empty())
+        return false;
+    box = _bounds;
+    return true;
+}
+
+// BVH 叶节点 [first, first + count) 的三角形位于块 first / kSize 起
+const TriangleBlock* Mesh::leafBlocks(int first) const {
+    return &_blocks[first / TriangleBlock::kSize];
+}
+
+const Vector3f& Mesh::cornerNormal(int tri, int k) const {
+    const Buffer<uint32_t>& idx = _normalIndices.empty() ? _indices : _normalIndices;
+    return _normals[idx[3 * tri + k]];
+}
+
+void Mesh::setHit(int idx, float t, Hit& h) const {
+    h.set(t, getMaterial(), _shadingNormals[idx]);
+}
+
+// 逐块求最近交点, 块内与块间均按三角形顺序比较, 结果与逐个调用 Triangle::intersect 相同
+bool Mesh::intersectBlocks(const TriangleBlock* blocks, int numBlocks,
+                           const Ray& r, float tmin, Hit& h) const {
+    bool result = false;
+    for (int bi = 0; bi < numBlocks; bi++) {
+        float t;
+        int lane = blocks[bi].closest(r, tmin, h.getT(), t);
+        if (lane >= 0) {
+            setHit(blocks[bi].prim[lane], t, h);
+            result = true;
+        }
+    }
     return result;
 }
+
+bool Mesh::occludedBlocks(const TriangleBlock* blocks, int numBlocks,
+                          const Ray& r, float tmin, float tmax) const {
+    float t[TriangleBlock::kSize];
+    for (int bi = 0; bi < numBlocks; bi++)
+        if (blocks[bi].intersect(r, tmin, tmax, t))
+            return true;
+    return false;
+}
+
+int Mesh::intersectBlocksPacket(const TriangleBlock* blocks, int numBlocks,
+                                const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    float tmax[RayPacket::kSize];
+    for (int i = 0; i < RayPacket::kSize; i++)
+        tmax[i] = hits[i].getT();
+
+    int updated = 0;
+    for (int bi = 0; bi < numBlocks; bi++) {
+        const TriangleBlock& block = blocks[bi];
+        for (int lane = 0; lane < TriangleBlock::kSize; lane++) {
+            if (block.prim[lane] < 0)
+                continue;
+            float ts[RayPacket::kSize];
+            int m = intersectTrianglePacket(block.getV0(lane), block.getE1(lane),
+                                            block.getE2(lane), rays, mask, tmin, tmax, ts);
+            for (int i = 0; m; i++, m >>= 1) {
+                if (m & 1) {
+                    setHit(block.prim[lane], ts[i], hits[i]);
+                    tmax[i] = ts[i];
+                    updated |= 1 << i;
+                }
+            }
+        }
+    }
+    return updated;
+}
+
+void Mesh::packBlocks(const int* trigs, int count, TriangleBlock* blocks) const {
+    for (int i = 0; i < count; i++)
+        blocks[i / TriangleBlock::kSize].set(i % TriangleBlock::kSize, trigs[i],
+                                             getVertex(trigs[i], 0), getVertex(trigs[i], 1),
+                                             getVertex(trigs[i], 2));
+}
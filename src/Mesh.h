@@ -1,32 +1,107 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include "BVH.h"
+#include "Buffer.h"
+#include "MeshCache.h"
 #include "Object3D.h"
 #include "ObjTriangle.h"
 #include "Octree.h"
+#include "TriangleBlock.h"
 #include "Vector2f.h"
 #include "Vector3f.h"
 
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
+// 网格使用的加速结构
+enum class AccelType {
+    Octree,
+    BVH,
+};
+
+class ThreadPool;
+
+// 网格的加载方式
+struct MeshOptions {
+    // 加载网格和构建加速结构所用的线程池, 为空时按 threads 临时创建一个
+    ThreadPool *pool = nullptr;
+    int threads = 1;       // 无线程池时的线程数, <= 0 表示使用全部硬件线程
+    bool cache = true;     // 读写二进制网格缓存 (见 MeshCache)
+    std::string cacheDir;  // 缓存目录, 为空时缓存写在 .obj 文件旁
+};
+
 class Mesh : public Object3D {
   public:
-    Mesh(const std::string &filename, Material *m);
+    // With options.cache an up to date cache of the file and its
+    // acceleration structure is mapped instead of parsing and building;
+    // otherwise the cache is (re)written after the build. Throws
+    // std::runtime_error if the file cannot be read.
+    Mesh(const std::string &filename, Material *m, AccelType accel = AccelType::BVH,
+         const MeshOptions &options = MeshOptions());
+    // Shades the geometry and the acceleration structure of mesh with m.
+    // Nothing is copied: mesh is kept alive as long as this one, so the
+    // scenes of a batch can share one load of each file.
+    Mesh(const std::shared_ptr<const Mesh> &mesh, Material *m);
+
+    // "octree" / "bvh", returns false for unknown names
+    static bool parseAccelType(const std::string &name, AccelType &accel);
+    static const char *accelTypeName(AccelType accel);
 
-    virtual bool intersect(const Ray &r, float tmin, Hit &h) const;
+    virtual bool intersect(const Ray &r, float tmin, Hit &h) const override;
+    virtual bool getBounds(Box &box) const override;
+    virtual bool occluded(const Ray &r, float tmin, float tmax) const override;
+    virtual int intersectPacket(const RayPacket &rays, int mask, float tmin, Hit *hits) const override;
 
-    virtual bool intersectTrig(int idx, const Ray &r) const;
+    // Leaf tests shared by the BVH and the octree: the triangles of a leaf
+    // are packed into consecutive TriangleBlocks.
+    bool intersectBlocks(const TriangleBlock *blocks, int numBlocks,
+                         const Ray &r, float tmin, Hit &h) const;
+    bool occludedBlocks(const TriangleBlock *blocks, int numBlocks,
+                        const Ray &r, float tmin, float tmax) const;
+    int intersectBlocksPacket(const TriangleBlock *blocks, int numBlocks,
+                              const RayPacket &rays, int mask, float tmin, Hit *hits) const;
 
-    const std::vector<Triangle> & getTriangles() const {
-        return _triangles;
+    // packs the given triangles into TriangleBlock::numBlocks(count)
+    // blocks, padding the last one
+    void packBlocks(const int *trigs, int count, TriangleBlock *blocks) const;
+
+    int getNumTriangles() const {
+        return (int)(_indices.size() / 3);
+    }
+
+    // 三角形 tri 的第 k 个顶点
+    const Vector3f &getVertex(int tri, int k) const {
+        return _positions[_indices[3 * tri + k]];
     }
 
   private:
-    std::vector<Triangle> _triangles;
-    mutable Octree octree;
-    mutable const Ray *ray;
-    mutable Hit *hit;
-    mutable float tm;
+    // maps the buffers and the acceleration structure from an up to date cache
+    bool loadCache(const std::string &filename, const std::string &cachePath);
+    void writeCache(const std::string &filename, const std::string &cachePath) const;
+    void buildAccel(const std::string &filename, ThreadPool &pool);
+
+    const Vector3f &cornerNormal(int tri, int k) const;
+    const TriangleBlock *leafBlocks(int first) const;
+    // 记录三角形 idx 处的交点
+    void setHit(int idx, float t, Hit &h) const;
+
+    // Shared vertex and index buffers. They own their elements after
+    // parsing the file and refer into _cache when it was loaded from there.
+    Buffer<Vector3f> _positions;       // 顶点
+    Buffer<Vector3f> _normals;         // 各顶点的平滑法向量, 其后为文件中的 vn
+    Buffer<uint32_t> _indices;         // 每个三角形 3 个顶点下标
+    Buffer<uint32_t> _normalIndices;   // 每个角点的法向量下标, 为空时与 _indices 相同
+    Buffer<Vector3f> _shadingNormals;  // 每个三角形的着色法向量
+    Buffer<TriangleBlock> _blocks;     // BVH 叶节点中的三角形, 按叶节点顺序
+    MeshCache _cache;
+    Box _bounds;      // 网格包围盒
+    AccelType _accel; // 使用的加速结构
+    Octree octree;
+    BVH bvh;
+    std::shared_ptr<const Mesh> _shared;  // 数据所属的网格, 为空表示自有
 };
 
 #endif
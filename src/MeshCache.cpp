@@ -0,0 +1,238 @@
+#include "MeshCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char kMagic[8] = {'A', '2', 'M', 'E', 'S', 'H', 0, 0};
+// reads back differently on a machine of the other byte order
+const uint32_t kByteOrder = 0x01020304;
+const size_t kAccelNameSize = 16;
+
+struct SourceInfo {
+    uint64_t size;
+    int64_t mtime;  // 纳秒
+};
+
+bool statSource(const std::string& source, SourceInfo& info) {
+    struct stat st;
+    if (stat(source.c_str(), &st) != 0)
+        return false;
+    info.size = (uint64_t)st.st_size;
+    info.mtime = (int64_t)st.st_mtime * 1000000000;
+#if defined(__APPLE__)
+    info.mtime += st.st_mtimespec.tv_nsec;
+#elif defined(__unix__)
+    info.mtime += st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+// 64-bit FNV-1a over 8-byte words, with an extra shift so high bits
+// feed back into the low ones. Only detects changed sources.
+uint64_t hashBytes(const char* p, size_t n) {
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t h = 0xcbf29ce484222325ull ^ n;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * prime;
+        h ^= h >> 32;
+    }
+    for (; i < n; i++)
+        h = (h ^ (unsigned char)p[i]) * prime;
+    return h;
+}
+
+bool hashSource(const std::string& source, uint64_t& hash) {
+    MappedFile file;
+    if (!file.open(source))
+        return false;
+    hash = hashBytes(file.data(), file.size());
+    return true;
+}
+
+size_t alignUp(size_t n) {
+    return (n + MeshCache::kAlignment - 1) / MeshCache::kAlignment * MeshCache::kAlignment;
+}
+
+std::string baseName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+}  // namespace
+
+struct MeshCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    char accel[kAccelNameSize];  // 加速结构名, 以 0 结尾
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+    float bounds[6];  // 网格包围盒 mn, mx
+    int32_t leafAlign;
+    uint32_t numSections;
+    struct {
+        uint64_t offset;  // 相对文件开头, kAlignment 对齐
+        uint64_t count;
+        uint32_t elemSize;
+        uint32_t reserved;
+    } sections[NumSections];
+};
+
+std::string MeshCache::path(const std::string& source, const std::string& cacheDir,
+                            const std::string& accel) {
+    if (cacheDir.empty())
+        return source + "." + accel + ".a2cache";
+    // meshes with the same name in different directories must not collide
+    std::ostringstream name;
+    name << cacheDir;
+    if (cacheDir.back() != '/' && cacheDir.back() != '\\')
+        name << '/';
+    name << baseName(source) << '-' << std::hex << hashBytes(source.data(), source.size())
+         << '.' << accel << ".a2cache";
+    return name.str();
+}
+
+bool MeshCache::writeFile(const std::string& path, const std::string& source,
+                          const std::string& accel, const Contents& contents) {
+    Header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.byteOrder = kByteOrder;
+    if (accel.size() >= kAccelNameSize)
+        return false;
+    memcpy(h.accel, accel.data(), accel.size());
+
+    SourceInfo info;
+    if (!statSource(source, info) || !hashSource(source, h.sourceHash))
+        return false;
+    h.sourceSize = info.size;
+    h.sourceMtime = info.mtime;
+
+    for (int dim = 0; dim < 3; dim++) {
+        h.bounds[dim] = contents.bounds.mn[dim];
+        h.bounds[3 + dim] = contents.bounds.mx[dim];
+    }
+    h.leafAlign = contents.leafAlign;
+    h.numSections = NumSections;
+    size_t offset = alignUp(sizeof(Header));
+    for (int s = 0; s < NumSections; s++) {
+        h.sections[s].offset = offset;
+        h.sections[s].count = contents.count[s];
+        h.sections[s].elemSize = contents.elemSize[s];
+        offset = alignUp(offset + contents.count[s] * contents.elemSize[s]);
+    }
+
+    // a cache directory is created on first use
+    const size_t slash = path.find_last_of("/\\");
+#if defined(__unix__) || defined(__APPLE__)
+    if (slash != std::string::npos && slash > 0) {
+        struct stat st;
+        const std::string dir = path.substr(0, slash);
+        if (stat(dir.c_str(), &st) != 0)
+            mkdir(dir.c_str(), 0755);
+    }
+#endif
+
+    // readers never see a half written cache
+    std::ostringstream tmpName;
+    tmpName << path << ".tmp";
+#if defined(__unix__) || defined(__APPLE__)
+    tmpName << getpid();
+#endif
+    const std::string tmp = tmpName.str();
+    {
+        std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+        const char zeros[kAlignment] = {};
+        out.write((const char*)&h, sizeof(h));
+        size_t pos = sizeof(h);
+        for (int s = 0; s < NumSections; s++) {
+            out.write(zeros, h.sections[s].offset - pos);
+            size_t bytes = h.sections[s].count * h.sections[s].elemSize;
+            if (bytes)
+                out.write((const char*)contents.data[s], bytes);
+            pos = h.sections[s].offset + bytes;
+        }
+        if (!out) {
+            out.close();
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MeshCache::open(const std::string& path, const std::string& source,
+                     const std::string& accel) {
+    close();
+    if (!_file.open(path) || _file.size() < sizeof(Header))
+        return false;
+    const Header& h = *(const Header*)_file.data();
+
+    bool valid = !memcmp(h.magic, kMagic, sizeof(kMagic)) && h.version == kVersion &&
+                 h.byteOrder == kByteOrder && h.numSections == NumSections &&
+                 !strncmp(h.accel, accel.c_str(), kAccelNameSize);
+    for (int s = 0; valid && s < NumSections; s++) {
+        const uint64_t offset = h.sections[s].offset;
+        const uint64_t count = h.sections[s].count;
+        const uint64_t elemSize = h.sections[s].elemSize;
+        valid = offset % kAlignment == 0 && offset <= _file.size() &&
+                (elemSize == 0 || count <= (_file.size() - offset) / elemSize);
+    }
+
+    // an unchanged size and mtime is trusted, otherwise the contents decide
+    SourceInfo info;
+    valid = valid && statSource(source, info) && info.size == h.sourceSize;
+    if (valid && info.mtime != h.sourceMtime) {
+        uint64_t hash;
+        valid = hashSource(source, hash) && hash == h.sourceHash;
+    }
+    if (!valid) {
+        _file.close();
+        return false;
+    }
+    _header = &h;
+    return true;
+}
+
+void MeshCache::close() {
+    _header = nullptr;
+    _file.close();
+}
+
+Box MeshCache::getBounds() const {
+    const float* b = _header->bounds;
+    return Box(b[0], b[1], b[2], b[3], b[4], b[5]);
+}
+
+int MeshCache::getLeafAlign() const {
+    return _header->leafAlign;
+}
+
+const void* MeshCache::section(Section s, size_t elemSize, size_t& count) const {
+    count = 0;
+    if (!_header || _header->sections[s].elemSize != elemSize || !_header->sections[s].count)
+        return nullptr;
+    count = (size_t)_header->sections[s].count;
+    return _file.data() + _header->sections[s].offset;
+}
@@ -0,0 +1,102 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "Box.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary cache of a mesh loaded from an OBJ file together with its
+// acceleration structure, so later runs skip parsing and building.
+//
+// The file is a fixed header followed by raw arrays ("sections") in the
+// in-memory layout of the renderer, each aligned to kAlignment. Opening it
+// maps the file and hands out pointers into the mapping: nothing is
+// copied or converted.
+//
+// A cache belongs to one source file. It is stale when the source size
+// differs, or when the modification time differs and a hash of the
+// contents does too; touching or copying the source keeps the cache.
+class MeshCache
+{
+  public:
+    // bump whenever the header or the layout of any section changes
+    static const uint32_t kVersion = 2;
+    static const size_t kAlignment = 64;
+
+    enum Section
+    {
+        Positions,       // Vector3f, 顶点
+        Normals,         // Vector3f, 平滑法向量及文件中的 vn
+        Indices,         // uint32_t, 每个三角形 3 个顶点下标
+        NormalIndices,   // uint32_t, 每个角点的法向量下标, 可为空
+        ShadingNormals,  // Vector3f, 每个三角形的着色法向量
+        Blocks,          // TriangleBlock, BVH 叶节点中的三角形
+        BVHNodes,        // BVHNode
+        BVHPrims,        // int32_t, BVH 叶节点的图元下标
+        OctreeBounds,    // Box, 八叉树根节点的包围盒
+        OctreeNodes,     // OctNode
+        OctreeBlocks,    // TriangleBlock, 八叉树叶节点中的三角形
+        NumSections
+    };
+
+    // Where the cache of source lives: next to it when cacheDir is empty,
+    // otherwise in cacheDir under a name derived from the source path.
+    // Every acceleration structure gets its own file.
+    static std::string path(const std::string &source, const std::string &cacheDir,
+                            const std::string &accel);
+
+    // What writeFile stores, with the element counts of every section
+    struct Contents
+    {
+        Box bounds;
+        int32_t leafAlign = 1;
+        const void *data[NumSections] = {};
+        uint64_t count[NumSections] = {};
+        uint32_t elemSize[NumSections] = {};
+
+        template <typename T>
+        void set(Section s, const T *p, size_t n)
+        {
+            data[s] = p;
+            count[s] = n;
+            elemSize[s] = sizeof(T);
+        }
+    };
+
+    // Writes the cache of source to path, through a temporary file that
+    // is renamed into place. Returns false if it cannot be written.
+    static bool writeFile(const std::string &path, const std::string &source,
+                          const std::string &accel, const Contents &contents);
+
+    // Maps the cache at path and checks it against source and accel.
+    // Returns false if it is missing, stale or was written by another
+    // version; the cache is closed then.
+    bool open(const std::string &path, const std::string &source, const std::string &accel);
+    void close();
+
+    bool isOpen() const { return _header != nullptr; }
+
+    Box getBounds() const;
+    int getLeafAlign() const;
+
+    // elements of section s, or nullptr when it is empty or elemSize
+    // differs from sizeof(T)
+    template <typename T>
+    const T *get(Section s, size_t &count) const
+    {
+        return (const T *)section(s, sizeof(T), count);
+    }
+
+  private:
+    struct Header;
+
+    const void *section(Section s, size_t elemSize, size_t &count) const;
+
+    MappedFile _file;
+    const Header *_header = nullptr;
+};
+
+#endif // MESH_CACHE_H
@@ -0,0 +1,307 @@
+#include "ObjLoader.h"
+
+#include "MappedFile.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// a chunk handed to one task is at least this large
+const size_t kMinChunkSize = 1 << 20;
+// chunks per thread, so faster threads can take over the rest
+const int kChunksPerThread = 4;
+
+// powers of ten that are exact in float
+const float kPow10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+const int kMaxPow10 = 10;
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && isBlank(*p))
+        p++;
+    return p;
+}
+
+// strtof on a NUL terminated copy of the token: the mapping has no terminator
+const char* parseFloatSlow(const char* p, const char* end, float& out) {
+    char buf[64];
+    int n = 0;
+    while (p + n < end && n < (int)sizeof(buf) - 1 && !isBlank(p[n]) && p[n] != '/')
+        buf[n] = p[n], n++;
+    buf[n] = 0;
+    char* stop;
+    out = std::strtof(buf, &stop);
+    return p + std::max(1, (int)(stop - buf));
+}
+
+// Decimal float with the same result as strtof.
+// When the digits fit in 24 bits and the power of ten is at most 10, both
+// are exact floats and a single IEEE multiply or divide rounds the exact
+// value correctly. That covers the coordinates OBJ exporters write;
+// anything else (long mantissas, large exponents, inf/nan) goes to strtof.
+const char* parseFloat(const char* p, const char* end, float& out) {
+    const char* start = p;
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+
+    uint64_t m = 0;
+    int exp10 = 0;
+    bool digits = false, exact = true;
+    for (; p < end && isDigit(*p); p++) {
+        digits = true;
+        if (m < (1ull << 24))
+            m = m * 10 + (*p - '0');
+        else
+            exact = false;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++) {
+            digits = true;
+            if (m < (1ull << 24))
+                m = m * 10 + (*p - '0'), exp10--;
+            else if (*p != '0')
+                exact = false;
+        }
+    }
+    if (!digits)
+        return parseFloatSlow(start, end, out);
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool eneg = false;
+        if (q < end && (*q == '-' || *q == '+'))
+            eneg = *q++ == '-';
+        if (q == end || !isDigit(*q))
+            return parseFloatSlow(start, end, out);
+        int e = 0;
+        for (; q < end && isDigit(*q); q++)
+            e = std::min(e * 10 + (*q - '0'), 100000);
+        exp10 += eneg ? -e : e;
+        p = q;
+    }
+    if (!exact || m > (1ull << 24) || exp10 < -kMaxPow10 || exp10 > kMaxPow10)
+        return parseFloatSlow(start, end, out);
+
+    float f = (float)m;
+    f = exp10 < 0 ? f / kPow10[-exp10] : f * kPow10[exp10];
+    out = neg ? -f : f;
+    return p;
+}
+
+const char* parseInt(const char* p, const char* end, int& out) {
+    bool neg = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        neg = *p++ == '-';
+    int v = 0;
+    for (; p < end && isDigit(*p); p++)
+        v = v * 10 + (*p - '0');
+    out = neg ? -v : v;
+    return p;
+}
+
+// One slice of the file, parsed independently of the others
+struct Chunk {
+    std::vector<Vector3f> positions;
+    std::vector<Vector2f> texCoords;
+    std::vector<Vector3f> normals;
+    std::vector<ObjTriangle> triangles;
+
+    // Corners (3 * triangle + corner) whose index was negative in the file.
+    // They hold chunk relative indices until the sizes of the preceding
+    // chunks are known.
+    std::vector<int> relPositions, relTexCoords, relNormals;
+};
+
+// Index of a corner attribute: 1-based or negative in the file.
+// Returns the 0-based index, chunk relative when rel is set.
+inline int resolveIndex(int raw, int count, bool& rel) {
+    rel = raw < 0;
+    return raw < 0 ? count + raw : raw - 1;
+}
+
+void parseFace(const char* p, const char* end, Chunk& c) {
+    struct Corner {
+        int v, vt, vn;
+        bool relV, relT, relN;
+    };
+    Corner first = {}, prev = {};
+    int n = 0;
+    while (true) {
+        p = skipBlanks(p, end);
+        if (p == end)
+            break;
+        // v, v/vt, v//vn or v/vt/vn
+        Corner k = {0, 0, -1, false, false, false};
+        int raw;
+        p = parseInt(p, end, raw);
+        if (raw == 0)
+            break;
+        k.v = resolveIndex(raw, (int)c.positions.size(), k.relV);
+        if (p < end && *p == '/') {
+            p++;
+            if (p < end && *p != '/') {
+                p = parseInt(p, end, raw);
+                if (raw != 0)
+                    k.vt = resolveIndex(raw, (int)c.texCoords.size(), k.relT);
+            }
+            if (p < end && *p == '/') {
+                p = parseInt(p + 1, end, raw);
+                if (raw != 0)
+                    k.vn = resolveIndex(raw, (int)c.normals.size(), k.relN);
+            }
+        }
+        while (p < end && !isBlank(*p))
+            p++;
+
+        if (n >= 2) {
+            // fan around the first corner
+            const Corner* corners[3] = {&first, &prev, &k};
+            ObjTriangle t;
+            int base = 3 * (int)c.triangles.size();
+            for (int ii = 0; ii < 3; ii++) {
+                const Corner& q = *corners[ii];
+                t[ii] = q.v;
+                t.texID[ii] = q.vt;
+                t.normalID[ii] = q.vn;
+                if (q.relV)
+                    c.relPositions.push_back(base + ii);
+                if (q.relT)
+                    c.relTexCoords.push_back(base + ii);
+                if (q.relN)
+                    c.relNormals.push_back(base + ii);
+            }
+            c.triangles.push_back(t);
+        }
+        if (n == 0)
+            first = k;
+        prev = k;
+        n++;
+    }
+}
+
+void parseLine(const char* p, const char* end, Chunk& c) {
+    p = skipBlanks(p, end);
+    if (end - p < 2)
+        return;
+    if (p[0] == 'v' && isBlank(p[1])) {  // 顶点
+        float xyz[3] = {0, 0, 0};
+        p += 2;
+        for (int ii = 0; ii < 3 && (p = skipBlanks(p, end)) < end; ii++)
+            p = parseFloat(p, end, xyz[ii]);
+        c.positions.push_back(Vector3f(xyz[0], xyz[1], xyz[2]));
+    } else if (p[0] == 'v' && p[1] == 't' && end - p > 2 && isBlank(p[2])) {  // 纹理坐标
+        float uv[2] = {0, 0};
+        p += 3;
+        for (int ii = 0; ii < 2 && (p = skipBlanks(p, end)) < end; ii++)
+            p = parseFloat(p, end, uv[ii]);
+        c.texCoords.push_back(Vector2f(uv[0], uv[1]));
+    } else if (p[0] == 'v' && p[1] == 'n' && end - p > 2 && isBlank(p[2])) {  // 法向量
+        float xyz[3] = {0, 0, 0};
+        p += 3;
+        for (int ii = 0; ii < 3 && (p = skipBlanks(p, end)) < end; ii++)
+            p = parseFloat(p, end, xyz[ii]);
+        c.normals.push_back(Vector3f(xyz[0], xyz[1], xyz[2]));
+    } else if (p[0] == 'f' && isBlank(p[1])) {  // 面
+        parseFace(p + 2, end, c);
+    }
+    // comments, groups, materials etc. are ignored
+}
+
+void parseChunk(const char* p, const char* end, Chunk& c) {
+    while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (!eol)
+            eol = end;
+        parseLine(p, eol, c);
+        p = eol + 1;
+    }
+}
+
+}  // namespace
+
+bool loadObj(const std::string& filename, ObjMesh& mesh, ThreadPool& pool) {
+    Stats::Timer timer(Stats::MeshLoad);
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+    const char* data = file.data();
+    const size_t size = file.size();
+
+    // split at line starts
+    size_t numChunks = std::min((size_t)pool.getNumThreads() * kChunksPerThread,
+                                size / kMinChunkSize);
+    numChunks = std::max<size_t>(1, pool.getNumThreads() > 1 ? numChunks : 1);
+    std::vector<size_t> bounds(numChunks + 1);
+    bounds[0] = 0;
+    bounds[numChunks] = size;
+    for (size_t ii = 1; ii < numChunks; ii++) {
+        size_t pos = std::max(bounds[ii - 1], size / numChunks * ii);
+        const char* eol = (const char*)memchr(data + pos, '\n', size - pos);
+        bounds[ii] = eol ? (size_t)(eol - data) + 1 : size;
+    }
+
+    std::vector<Chunk> chunks(numChunks);
+    pool.parallelFor((int)numChunks, [&](int ii) {
+        parseChunk(data + bounds[ii], data + bounds[ii + 1], chunks[ii]);
+    });
+
+    // every chunk lands at the end of the preceding ones
+    std::vector<size_t> vOff(numChunks + 1, 0), vtOff(numChunks + 1, 0);
+    std::vector<size_t> vnOff(numChunks + 1, 0), fOff(numChunks + 1, 0);
+    for (size_t ii = 0; ii < numChunks; ii++) {
+        vOff[ii + 1] = vOff[ii] + chunks[ii].positions.size();
+        vtOff[ii + 1] = vtOff[ii] + chunks[ii].texCoords.size();
+        vnOff[ii + 1] = vnOff[ii] + chunks[ii].normals.size();
+        fOff[ii + 1] = fOff[ii] + chunks[ii].triangles.size();
+    }
+    mesh.positions.resize(vOff[numChunks]);
+    mesh.texCoords.resize(vtOff[numChunks]);
+    mesh.normals.resize(vnOff[numChunks]);
+    mesh.triangles.resize(fOff[numChunks]);
+
+    pool.parallelFor((int)numChunks, [&](int ii) {
+        Chunk& c = chunks[ii];
+        for (int r : c.relPositions)
+            c.triangles[r / 3][r % 3] += (int)vOff[ii];
+        for (int r : c.relTexCoords)
+            c.triangles[r / 3].texID[r % 3] += (int)vtOff[ii];
+        for (int r : c.relNormals)
+            c.triangles[r / 3].normalID[r % 3] += (int)vnOff[ii];
+        std::copy(c.positions.begin(), c.positions.end(), mesh.positions.begin() + vOff[ii]);
+        std::copy(c.texCoords.begin(), c.texCoords.end(), mesh.texCoords.begin() + vtOff[ii]);
+        std::copy(c.normals.begin(), c.normals.end(), mesh.normals.begin() + vnOff[ii]);
+        std::copy(c.triangles.begin(), c.triangles.end(), mesh.triangles.begin() + fOff[ii]);
+        c = Chunk();
+    });
+
+    // drop faces pointing outside the buffers
+    const int nv = (int)mesh.positions.size();
+    const int nvt = (int)mesh.texCoords.size();
+    const int nvn = (int)mesh.normals.size();
+    auto bad = [&](ObjTriangle& t) {
+        for (int ii = 0; ii < 3; ii++) {
+            if (t[ii] < 0 || t[ii] >= nv)
+                return true;
+            if (t.texID[ii] < 0 || (t.texID[ii] >= nvt && t.texID[ii] != 0))
+                return true;
+            if (t.normalID[ii] < -1 || t.normalID[ii] >= nvn)
+                return true;
+        }
+        return false;
+    };
+    size_t before = mesh.triangles.size();
+    mesh.triangles.erase(std::remove_if(mesh.triangles.begin(), mesh.triangles.end(), bad),
+                         mesh.triangles.end());
+    if (mesh.triangles.size() != before)
+        std::cerr << "Warning: " << filename << ": dropped " << before - mesh.triangles.size()
+                  << " faces with invalid indices" << std::endl;
+    return true;
+}
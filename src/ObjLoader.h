@@ -0,0 +1,29 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "ObjTriangle.h"
+#include "Vector2f.h"
+#include "Vector3f.h"
+
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Contents of an OBJ file as shared vertex and index buffers.
+// Polygons are fan-triangulated around their first corner and relative
+// (negative) indices are resolved, so every index is 0-based.
+struct ObjMesh {
+    std::vector<Vector3f> positions;     // v
+    std::vector<Vector2f> texCoords;     // vt
+    std::vector<Vector3f> normals;       // vn
+    std::vector<ObjTriangle> triangles;  // f
+};
+
+// Loads an OBJ file through a memory mapping, parsing chunks of it as
+// tasks of pool.
+// Faces with indices out of range are dropped with a warning.
+// Returns false if the file cannot be opened.
+bool loadObj(const std::string& filename, ObjMesh& mesh, ThreadPool& pool);
+
+#endif  // OBJ_LOADER_H
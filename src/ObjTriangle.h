@@ -7,13 +7,15 @@
 struct ObjTriangle {
     ObjTriangle() :
         x{ { 0, 0, 0 } },
-        texID{ { 0, 0, 0 } }
+        texID{ { 0, 0, 0 } },
+        normalID{ { -1, -1, -1 } }
     {
     }
 
     ObjTriangle(int a, int b, int c) :
         x{ { a, b, c } },
-        texID{ { 0, 0, 0 } }
+        texID{ { 0, 0, 0 } },
+        normalID{ { -1, -1, -1 } }
     {
     }
 
@@ -31,6 +33,7 @@ struct ObjTriangle {
 
     std::array<int, 3> x;
     std::array<int, 3> texID;
+    std::array<int, 3> normalID;  // vn 下标, -1 表示未指定
 };
 
 #endif // OBJ_TRIANGLE_H
@@ -1,4 +1,17 @@
 #include "Object3D.h"
+#include "Simd.h"
+#include "Stats.h"
+#include "TriangleBlock.h"
+
+#include <cmath>
+
+int Object3D::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    int updated = 0;
+    for (int i = 0; i < RayPacket::kSize; i++)
+        if ((mask & (1 << i)) && intersect(rays.getRay(i), tmin, hits[i]))
+            updated |= 1 << i;
+    return updated;
+}
 
 // 判断球体是否与光线相交
 bool Sphere::intersect(const Ray& r, float tmin, Hit& h) const {
@@ -52,9 +65,53 @@ bool Sphere::intersect(const Ray& r, float tmin, Hit& h) const {
     return false;
 }
 
+// 4条光线同时与球体求交, 运算步骤与 Sphere::intersect 完全一致
+int Sphere::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    Float4 dx = Float4::load(rays.dx), dy = Float4::load(rays.dy), dz = Float4::load(rays.dz);
+    Float4 ox = Float4::load(rays.ox) - Float4(_center[0]);
+    Float4 oy = Float4::load(rays.oy) - Float4(_center[1]);
+    Float4 oz = Float4::load(rays.oz) - Float4(_center[2]);
+
+    Float4 a = dx * dx + dy * dy + dz * dz;
+    Float4 b = Float4(2.0f) * (dx * ox + dy * oy + dz * oz);
+    Float4 c = (ox * ox + oy * oy + oz * oz) - Float4(_radius * _radius);
+    Float4 delta = b * b - Float4(4.0f) * a * c;
+    mask &= ~(delta < Float4(0.0f)).mask();  // Delta<0 无解
+    if (!mask)
+        return 0;
+
+    Float4 d = Float4::sqrt(delta);
+    Float4 tplus = (-b + d) / (Float4(2.0f) * a);
+    Float4 tminus = (-b - d) / (Float4(2.0f) * a);
+    Float4 tm(tmin);
+    mask &= ~((tplus < tm) & (tminus < tm)).mask();  // 两交点都在相机后面
+
+    Float4 t = Float4::select(tminus > tm, tminus, Float4(10000.0f));
+    t = Float4::select((tplus > tm) & (tminus < tm), tplus, t);
+    float ts[RayPacket::kSize];
+    t.store(ts);
+
+    int updated = 0;
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        if ((mask & (1 << i)) && ts[i] < hits[i].getT()) {
+            Vector3f normal = rays.getRay(i).pointAtParameter(ts[i]) - _center;
+            hits[i].set(ts[i], this->material, normal.normalized());
+            updated |= 1 << i;
+        }
+    }
+    return updated;
+}
+
+bool Sphere::getBounds(Box& box) const {
+    Vector3f r(std::abs(_radius));
+    box = Box(_center - r, _center + r);
+    return true;
+}
+
 // Add object to group
 void Group::addObject(Object3D* obj) {
     m_members.push_back(obj);
+    _built = false;
 }
 
 // Return number of objects in group
@@ -62,11 +119,93 @@ int Group::getGroupSize() const {
     return (int)m_members.size();
 }
 
+void Group::build() {
+    _bounded.clear();
+    _unbounded.clear();
+    std::vector<Box> bounds;
+    for (int i = 0; i < (int)m_members.size(); i++) {
+        Box box;
+        if (m_members[i]->getBounds(box)) {
+            _bounded.push_back(i);
+            bounds.push_back(box);
+        } else {
+            _unbounded.push_back(i);
+        }
+    }
+    _bvh.build(bounds);
+    _built = true;
+}
+
+bool Group::getBounds(Box& box) const {
+    box = Box::empty();
+    for (Object3D* o : m_members) {
+        Box b;
+        if (!o->getBounds(b))
+            return false;  // 含有无界物体
+        box.extend(b);
+    }
+    return !m_members.empty();
+}
+
+bool Group::occluded(const Ray& r, float tmin, float tmax) const {
+    if (!_built) {
+        for (Object3D* o : m_members)
+            if (o->occluded(r, tmin, tmax))
+                return true;
+        return false;
+    }
+
+    for (int i : _unbounded)
+        if (m_members[i]->occluded(r, tmin, tmax))
+            return true;
+    return _bvh.occluded(r, tmin, tmax,
+                         [&](int i) { return m_members[_bounded[i]]->occluded(r, tmin, tmax); });
+}
+
+int Group::intersectMember(int i, const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    int updated = m_members[i]->intersectPacket(rays, mask, tmin, hits);
+    for (int lane = 0; lane < RayPacket::kSize; lane++)
+        if (updated & (1 << lane))
+            hits[lane].object = i;
+    return updated;
+}
+
+bool Group::intersectMember(int i, const Ray& r, float tmin, Hit& h) const {
+    if (!m_members[i]->intersect(r, tmin, h))
+        return false;
+    h.object = i;
+    return true;
+}
+
+int Group::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    if (!_built)
+        return Object3D::intersectPacket(rays, mask, tmin, hits);
+
+    int updated = 0;
+    for (int i : _unbounded)
+        updated |= intersectMember(i, rays, mask, tmin, hits);
+    updated |= _bvh.intersectPacket(
+        rays, mask, tmin, hits,
+        [&](int i, const Ray& r, Hit& h) { return intersectMember(_bounded[i], r, tmin, h); },
+        [&](int i, int lanes) { return intersectMember(_bounded[i], rays, lanes, tmin, hits); });
+    return updated;
+}
+
 bool Group::intersect(const Ray& r, float tmin, Hit& h) const {
     bool hit = false;
-    for (Object3D* o : m_members)      // 遍历所有物体
-        if (o->intersect(r, tmin, h))  // 如果发生相交
+    if (!_built) {
+        for (int i = 0; i < (int)m_members.size(); i++)  // 遍历所有物体
+            if (intersectMember(i, r, tmin, h))            // 如果发生相交
+                hit = true;
+        return hit;
+    }
+
+    // 先测试无界物体, 得到的交点可以剪裁BVH遍历
+    for (int i : _unbounded)
+        if (intersectMember(i, r, tmin, h))
             hit = true;
+    if (_bvh.intersect(r, tmin, h, [&](int i) { return intersectMember(_bounded[i], r, tmin, h); }))
+        hit = true;
     return hit;
 }
 
@@ -81,7 +220,14 @@ bool Plane::intersect(const Ray& r, float tmin, Hit& h) const {
     return true;
 }
 
-bool Triangle::intersect(const Ray& r, float tmin, Hit& h) const {
+bool Triangle::getBounds(Box& box) const {
+    box = Box::empty();
+    for (int i = 0; i < 3; i++)
+        box.extend(_v[i]);
+    return true;
+}
+
+bool Triangle::intersectT(const Ray& r, float tmin, float tmax, float& t) const {
     Vector3f S = r.getOrigin() - _v[0];
     Vector3f E1 = _v[1] - _v[0];
     Vector3f E2 = _v[2] - _v[0];
@@ -89,11 +235,17 @@ bool Triangle::intersect(const Ray& r, float tmin, Hit& h) const {
     Vector3f S2 = Vector3f::cross(S, E1);
 
     float S1E1 = Vector3f::dot(S1, E1);
-    float t = Vector3f::dot(S2, E2) / S1E1;
+    t = Vector3f::dot(S2, E2) / S1E1;
     float b1 = Vector3f::dot(S1, S) / S1E1;
     float b2 = Vector3f::dot(S2, r.getDirection()) / S1E1;
 
-    if (t > tmin && t < h.getT() && b1 > 0 && b2 > 0 && (1 - b1 - b2) > 0) {
+    return t > tmin && t < tmax && b1 > 0 && b2 > 0 && (1 - b1 - b2) > 0;
+}
+
+bool Triangle::intersect(const Ray& r, float tmin, Hit& h) const {
+    Stats::count(Stats::TriangleTests);
+    float t;
+    if (intersectT(r, tmin, h.getT(), t)) {
         h.set(t, material,
               (_normals[0] + _normals[1] + _normals[2]).normalized());
         return true;
@@ -101,12 +253,87 @@ bool Triangle::intersect(const Ray& r, float tmin, Hit& h) const {
     return false;
 }
 
-bool Transform::intersect(const Ray& r, float tmin, Hit& h) const {
+// 一个三角形与4条光线求交, 运算步骤与 Triangle::intersectT 完全一致
+int Triangle::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    float tmax[RayPacket::kSize];
+    for (int i = 0; i < RayPacket::kSize; i++)
+        tmax[i] = hits[i].getT();
+    Stats::count(Stats::TriangleTests, numLanes(mask));
+    float ts[RayPacket::kSize];
+    mask = intersectTrianglePacket(_v[0], _v[1] - _v[0], _v[2] - _v[0], rays, mask, tmin, tmax, ts);
+    if (!mask)
+        return 0;
+
+    Vector3f normal = (_normals[0] + _normals[1] + _normals[2]).normalized();
+    for (int i = 0; i < RayPacket::kSize; i++)
+        if (mask & (1 << i))
+            hits[i].set(ts[i], material, normal);
+    return mask;
+}
+
+bool Triangle::occluded(const Ray& r, float tmin, float tmax) const {
+    Stats::count(Stats::TriangleTests);
+    float t;
+    return intersectT(r, tmin, tmax, t);
+}
+
+bool Transform::getBounds(Box& box) const {
+    Box local;
+    if (!_object->getBounds(local))
+        return false;
+    // 变换局部包围盒的8个顶点
+    box = Box::empty();
+    for (int i = 0; i < 8; i++) {
+        Vector3f corner((i & 4) ? local.mx[0] : local.mn[0],
+                        (i & 2) ? local.mx[1] : local.mn[1],
+                        (i & 1) ? local.mx[2] : local.mn[2]);
+        box.extend((_mat * Vector4f(corner, 1.0f)).homogenized().xyz());
+    }
+    return true;
+}
+
+Ray Transform::toObject(const Ray& r, float& scale) const {
     Vector3f orig_obj =
         (_matInv * Vector4f(r.getOrigin(), 1.0f)).homogenized().xyz();
     Vector3f dirc_obj = (_matInv * Vector4f(r.getDirection(), 0.0f)).xyz();
-    float scale = dirc_obj.abs();
-    Ray r_obj = Ray(orig_obj, dirc_obj.normalized());
+    scale = dirc_obj.abs();
+    return Ray(orig_obj, dirc_obj.normalized());
+}
+
+bool Transform::occluded(const Ray& r, float tmin, float tmax) const {
+    float scale;
+    Ray r_obj = toObject(r, scale);
+    return _object->occluded(r_obj, tmin, tmax * scale);
+}
+
+int Transform::intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const {
+    RayPacket local;
+    Hit localHits[RayPacket::kSize];
+    float scale[RayPacket::kSize];
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        if (mask & (1 << i)) {
+            local.set(i, toObject(rays.getRay(i), scale[i]));
+            localHits[i] = hits[i];
+            localHits[i].t *= scale[i];
+        }
+    }
+    local.fillInactive(mask);
+
+    int updated = _object->intersectPacket(local, mask, tmin, localHits);
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        if (updated & (1 << i)) {
+            float t = localHits[i].getT() / scale[i];
+            Vector3f N = localHits[i].getNormal();
+            N = (_matInvT * Vector4f(N, 0.0f)).xyz().normalized();
+            hits[i].set(t, localHits[i].getMaterial(), N);
+        }
+    }
+    return updated;
+}
+
+bool Transform::intersect(const Ray& r, float tmin, Hit& h) const {
+    float scale;
+    Ray r_obj = toObject(r, scale);
 
     Hit h_obj = h;
     h_obj.t *= scale;
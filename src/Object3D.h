@@ -1,7 +1,10 @@
 #ifndef OBJECT3D_H
 #define OBJECT3D_H
 
+#include "BVH.h"
+#include "Box.h"
 #include "Ray.h"
+#include "RayPacket.h"
 #include "Material.h"
 
 #include <string>
@@ -14,6 +17,19 @@ class Object3D {
     std::string getType() const { return type; }
     Material* getMaterial() const { return material; }
     virtual bool intersect(const Ray& r, float tmin, Hit& h) const = 0;
+    // 物体的包围盒, 无界物体(如平面)返回false
+    virtual bool getBounds(Box& /*box*/) const { return false; }
+    // Any-hit query for shadow rays: is the ray blocked within (tmin, tmax)?
+    // The default finds the closest hit; containers override it to stop early.
+    virtual bool occluded(const Ray& r, float tmin, float tmax) const {
+        Hit h;
+        h.t = tmax;
+        return intersect(r, tmin, h) && h.getT() < tmax;
+    }
+    // Packet version of intersect for the lanes set in mask, hits[i] belongs
+    // to lane i. Returns the lanes whose hit was updated.
+    // The default traces the lanes one by one.
+    virtual int intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const;
 
     std::string type;
     Material* material;  // 物体材质
@@ -28,6 +44,8 @@ class Sphere : public Object3D {
     Sphere(const Vector3f& center, float radius, Material* material)
         : Object3D(material), _center(center), _radius(radius) {}
     virtual bool intersect(const Ray& r, float tmin, Hit& h) const override;
+    virtual bool getBounds(Box& box) const override;
+    virtual int intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const override;
 
    private:
     Vector3f _center;  // 球心位置
@@ -37,11 +55,29 @@ class Sphere : public Object3D {
 class Group : public Object3D {
    public:
     virtual bool intersect(const Ray& r, float tmin, Hit& h) const override;
+    virtual bool getBounds(Box& box) const override;
+    virtual bool occluded(const Ray& r, float tmin, float tmax) const override;
+    virtual int intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const override;
     void addObject(Object3D* obj);
     int getGroupSize() const;
+    // Hits found by intersect / intersectPacket get the index of the
+    // member they belong to in Hit::object.
+
+    // Builds the top-level BVH over the bounded members.
+    // Unbounded members (planes) are tested separately on every ray.
+    // Must be called again after adding objects.
+    void build();
 
    private:
+    // 与成员 i 求交, 并把更新的交点记为属于成员 i
+    bool intersectMember(int i, const Ray& r, float tmin, Hit& h) const;
+    int intersectMember(int i, const RayPacket& rays, int mask, float tmin, Hit* hits) const;
+
     std::vector<Object3D*> m_members;
+    std::vector<int> _bounded;    // 进入BVH的物体在 m_members 中的下标, 下标即BVH图元编号
+    std::vector<int> _unbounded;  // 无包围盒的物体在 m_members 中的下标
+    BVH _bvh;                           // 顶层加速结构
+    bool _built = false;
 };
 
 class Plane : public Object3D {
@@ -66,7 +102,13 @@ class Triangle : public Object3D {
              Material* m)
         : Object3D(m), _v{a, b, c}, _normals{na, nb, nc} {}
     virtual bool intersect(const Ray& ray, float tmin, Hit& hit) const override;
-    
+    virtual bool getBounds(Box& box) const override;
+    virtual bool occluded(const Ray& r, float tmin, float tmax) const override;
+    virtual int intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const override;
+
+    // Möller-Trumbore: distance to the triangle if it lies in (tmin, tmax)
+    bool intersectT(const Ray& r, float tmin, float tmax, float& t) const;
+
     const Vector3f& getVertex(int index) const {
         assert(index < 3);
         return _v[index];
@@ -94,8 +136,14 @@ class Transform : public Object3D {
         _matInvT = _matInv.transposed();
     }
     virtual bool intersect(const Ray& r, float tmin, Hit& h) const override;
+    virtual bool getBounds(Box& box) const override;
+    virtual bool occluded(const Ray& r, float tmin, float tmax) const override;
+    virtual int intersectPacket(const RayPacket& rays, int mask, float tmin, Hit* hits) const override;
 
    private:
+    // 将光线变换到局部对象坐标系, scale 为方向向量的缩放比例
+    Ray toObject(const Ray& r, float& scale) const;
+
     Object3D* _object;  // un-transformed object
     Matrix4f _mat, _matInv, _matInvT;  // transformation matrix
 };
@@ -2,7 +2,13 @@
 #include "Vector3f.h"
 #include "Mesh.h"
 #include "Octree.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <utility>
 #include <vector>
 
 ///@brief two intervals intersect
@@ -46,44 +52,52 @@ inside(const Box &a, const Box &b)
 Box
 trigBox(int t, const Mesh &m)
 {
-    const auto &tri = m.getTriangles();
-
     Box b;
-    b.mn = tri[t].getVertex(0);
-    b.mx = tri[t].getVertex(0);
+    b.mn = m.getVertex(t, 0);
+    b.mx = m.getVertex(t, 0);
 
     for (int ii = 1; ii< 3; ii++) {
+        const Vector3f &v = m.getVertex(t, ii);
         for (int dim = 0; dim < 3; dim++) {
-            if (b.mn[dim] > tri[t].getVertex(ii)[dim]) {
-                b.mn[dim] = tri[t].getVertex(ii)[dim];
+            if (b.mn[dim] > v[dim]) {
+                b.mn[dim] = v[dim];
             }
-            if (b.mx[dim] < tri[t].getVertex(ii)[dim]) {
-                b.mx[dim] = tri[t].getVertex(ii)[dim];
+            if (b.mx[dim] < v[dim]) {
+                b.mx[dim] = v[dim];
             }
         }
     }
     return b;
 }
 
-///@brief pbox parent's box
+///@brief builds the subtree of outNodes[index], whose box is pbox,
+/// appending its descendants to outNodes and its leaf triangles to outTrigs.
+/// Leaves reference ranges of outTrigs until build() packs them into blocks.
 void
-Octree::buildNode(OctNode *parent,
+Octree::buildNode(std::vector<OctNode> &outNodes,
+                  std::vector<int> &outTrigs,
+                  uint32_t index,
                   const Box &pbox,
                   const std::vector<int> &trigs,
                   const Mesh &m,
-                  int level)
+                  const std::vector<Box> &trigBoxes,
+                  ThreadPool *pool,
+                  int level) const
 {
     if (trigs.size() <= Octree::max_trig || level > maxLevel) {
-        parent->obj = trigs;
+        outNodes[index].offset = (uint32_t)outTrigs.size();
+        outNodes[index].count = (uint32_t)trigs.size();
+        outTrigs.insert(outTrigs.end(), trigs.begin(), trigs.end());
         return;
     }
 
     level++;
 
     // Initialize 8 children
-    for (int ii = 0; ii < 8; ii++) {
-        parent->child[ii] = new OctNode();
-    }
+    const uint32_t first = (uint32_t)outNodes.size();
+    outNodes[index].offset = first;
+    outNodes[index].count = OctNode::kInner;
+    outNodes.resize(first + 8);
 
     const Vector3f &mn = pbox.mn;
     const Vector3f &mx = pbox.mx;
@@ -99,34 +113,69 @@ Octree::buildNode(OctNode *parent,
     cBox[6] = Box(mid[0], mid[1],  mn[2],  mx[0],  mx[1], mid[2]);
     cBox[7] = Box(mid[0], mid[1], mid[2],  mx[0],  mx[1],  mx[2]);
 
-    for (int ii = 0; ii < 8; ii++) {
-        std::vector<int> childTrigs;
+    auto childTrigs = [&](int ii) {
+        std::vector<int> result;
         for (unsigned int vi = 0; vi < trigs.size(); vi++) {
             int trigIdx = trigs[vi];
-            Box tBox = trigBox(trigIdx, m);
+            Box tBox = trigBoxes[trigIdx];
             if (inside(tBox, cBox[ii]) || boxOverlap(&tBox, &(cBox[ii]))) {
-                childTrigs.push_back(trigIdx);
+                result.push_back(trigIdx);
             }
         }
-        buildNode(parent->child[ii], cBox[ii], childTrigs, m, level);
+        return result;
+    };
+
+    if (pool && trigs.size() >= kParallelBuildSize) {
+        // Every child is built into arrays of its own, rooted at index 0,
+        // and spliced in child order afterwards: the same layout as the
+        // serial build.
+        struct Subtree
+        {
+            std::vector<OctNode> nodes;
+            std::vector<int> trigs;
+        };
+        Subtree sub[8];
+        TaskGroup group;
+        for (int ii = 0; ii < 8; ii++) {
+            pool->submit(group, [&, ii]() {
+                sub[ii].nodes.resize(1);
+                buildNode(sub[ii].nodes, sub[ii].trigs, 0, cBox[ii], childTrigs(ii), m,
+                          trigBoxes, pool, level);
+            });
+        }
+        pool->wait(group);
+        for (int ii = 0; ii < 8; ii++) {
+            // local node j > 0 lands at nodeBase + j
+            const uint32_t nodeBase = (uint32_t)outNodes.size() - 1;
+            const uint32_t trigBase = (uint32_t)outTrigs.size();
+            for (OctNode &n : sub[ii].nodes) {
+                n.offset += n.isTerm() ? trigBase : nodeBase;
+            }
+            outNodes[first + ii] = sub[ii].nodes[0];
+            outNodes.insert(outNodes.end(), sub[ii].nodes.begin() + 1, sub[ii].nodes.end());
+            outTrigs.insert(outTrigs.end(), sub[ii].trigs.begin(), sub[ii].trigs.end());
+            sub[ii] = Subtree();
+        }
+    } else {
+        for (int ii = 0; ii < 8; ii++) {
+            buildNode(outNodes, outTrigs, first + ii, cBox[ii], childTrigs(ii), m,
+                      trigBoxes, pool, level);
+        }
     }
 }
 
 void
-Octree::build(Mesh *m)
+Octree::build(const Mesh &m, ThreadPool *pool)
 {
-    mesh = m;
-
-    const auto &tri = mesh->getTriangles();
-    assert(!tri.empty());
+    const int numTrigs = m.getNumTriangles();
+    assert(numTrigs > 0);
 
     // compute bounding box for m
-    box.mn = tri[0].getVertex(0);
-    box.mx = tri[0].getVertex(0);
-    for (unsigned int ii = 0; ii < tri.size(); ii++) {
-        const auto &t = tri[ii];
+    box.mn = m.getVertex(0, 0);
+    box.mx = m.getVertex(0, 0);
+    for (int ii = 0; ii < numTrigs; ii++) {
         for (int vi = 0; vi < 3; ++vi) {
-            const auto &v = t.getVertex(vi);
+            const auto &v = m.getVertex(ii, vi);
             for (int dim = 0; dim < 3; dim++) {
                 if (box.mn[dim] > v[dim]) {
                     box.mn[dim] = v[dim];
@@ -138,11 +187,66 @@ Octree::build(Mesh *m)
         }
     }
 
-    std::vector<int> trigs(tri.size());
+    // every level tests each triangle against 8 children: box it once
+    std::vector<Box> trigBoxes(numTrigs);
+    std::vector<int> trigs(numTrigs);
     for (unsigned int ii = 0; ii < trigs.size(); ii++) {
+        trigBoxes[ii] = trigBox(ii, m);
         trigs[ii] = ii;
     }
-    buildNode(&root, box, trigs, *mesh, 0);
+    std::vector<OctNode> outNodes(1);
+    std::vector<int> outTrigs;
+    buildNode(outNodes, outTrigs, 0, box, trigs, m, trigBoxes, pool, 0);
+    std::vector<Box>().swap(trigBoxes);
+    std::vector<int>().swap(trigs);
+
+    // Now that the sizes of all leaves are known the blocks are allocated
+    // once; each leaf turns from a range of outTrigs into one of blocks.
+    std::vector<uint32_t> leafTrigs(outNodes.size());
+    uint32_t numBlocks = 0;
+    for (size_t ii = 0; ii < outNodes.size(); ii++) {
+        OctNode &n = outNodes[ii];
+        if (n.isTerm()) {
+            leafTrigs[ii] = n.offset;
+            n.offset = numBlocks;
+            numBlocks += TriangleBlock::numBlocks((int)n.count);
+        }
+    }
+    std::vector<TriangleBlock> outBlocks(numBlocks);
+    auto packLeaf = [&](size_t ii) {
+        OctNode &n = outNodes[ii];
+        if (n.isTerm()) {
+            m.packBlocks(outTrigs.data() + leafTrigs[ii], (int)n.count,
+                         outBlocks.data() + n.offset);
+            n.count = TriangleBlock::numBlocks((int)n.count);
+        }
+    };
+    const int kPackChunk = 4096;
+    const int numChunks = (int)((outNodes.size() + kPackChunk - 1) / kPackChunk);
+    auto packChunk = [&](int chunk) {
+        size_t end = std::min(outNodes.size(), (size_t)(chunk + 1) * kPackChunk);
+        for (size_t ii = (size_t)chunk * kPackChunk; ii < end; ii++) {
+            packLeaf(ii);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(numChunks, packChunk);
+    } else {
+        for (int chunk = 0; chunk < numChunks; chunk++) {
+            packChunk(chunk);
+        }
+    }
+    nodes.assign(std::move(outNodes));
+    blocks.assign(std::move(outBlocks));
+}
+
+void
+Octree::view(const Box &bounds, const OctNode *nodeData, size_t numNodes,
+             const TriangleBlock *blockData, size_t numBlocks)
+{
+    box = bounds;
+    nodes.view(nodeData, numNodes);
+    blocks.view(blockData, numBlocks);
 }
 
 int
@@ -198,129 +302,175 @@ new_node(float txm, int x,
     return z;
 }
 
+///@brief parametric midpoint of a slab [t0, t1] spanning [lo, hi] in space.
+/// A ray parallel to the slab has infinite t0 and t1, so their average is
+/// useless: the midplane is then never crossed and lies either ahead
+/// (origin below it) or behind (origin above it).
+static float
+mid_t(float t0, float t1, float dir, float orig, float lo, float hi)
+{
+    if (dir == 0) {
+        return orig < 0.5f * (lo + hi) ? std::numeric_limits<float>::infinity()
+                                       : -std::numeric_limits<float>::infinity();
+    }
+    return 0.5f * (t0 + t1);
+}
+
 bool
-Octree::proc_subtree(float tx0, 
-                     float ty0, 
-                     float tz0, 
-                     float tx1, 
-                     float ty1, 
-                     float tz1, 
-                     OctNode *node,
-                     const Ray &ray)
+Octree::traverse(const float *ro, const float *rd,
+                 const float *rootT0, const float *rootT1,
+                 TraversalContext &ctx) const
 {
-    bool intersected = false;
+    // The octree works along the normalized direction; Hit::t is along
+    // the ray's own direction. Nodes are visited in the order the ray
+    // enters them, so once a node starts beyond the closest hit so far,
+    // no later node can improve it. The margin absorbs rounding of the
+    // entry parameters.
+    const float tscale = ctx.ray.getDirection().abs() * (1 + kEntryMargin);
 
-    if (tx1 < 0 || ty1 < 0 || tz1 < 0) {
-        return intersected;
-    }
+    // one frame per inner node on the path, resumed at its next child
+    struct Frame
+    {
+        const OctNode *node;
+        float t0[3], tm[3], t1[3];  // 节点在各轴上的进入/中点/离开参数
+        float lo[3], hi[3];         // 节点在镜像坐标系中的空间范围
+        int next;                   // 下一个要访问的子节点, 8 表示已结束
+    };
+    Frame stack[kStackSize];
+    int sp = 0;
 
-    if (node->isTerm()) {
-        //loop over things
-        for (size_t ii = 0; ii < node->obj.size(); ii++) {
-            bool result = mesh->intersectTrig(node->obj[ii],ray);
-            intersected = intersected || result;
-        }
-        return intersected;
+    bool intersected = false;
+    int visited = 0;  // 进入的节点数
+    int tested = 0;   // 测试过的三角形块数
+    const OctNode *node = &nodes[0];
+    float t0[3], t1[3], lo[3], hi[3];
+    for (int dim = 0; dim < 3; dim++) {
+        t0[dim] = rootT0[dim];
+        t1[dim] = rootT1[dim];
+        lo[dim] = box.mn[dim];
+        hi[dim] = box.mx[dim];
     }
+    while (true) {
+        float entry = std::max(std::max(t0[0], t0[1]), t0[2]);
+        if (entry > ctx.hit.getT() * tscale) {
+            break;
+        }
+        if (t1[0] >= 0 && t1[1] >= 0 && t1[2] >= 0) {
+            visited++;
+            if (node->isTerm()) {
+                //loop over things
+                const TriangleBlock *leaf = blocks.data() + node->offset;
+                int numBlocks = (int)node->count;
+                tested += numBlocks;
+                if (ctx.anyHit) {
+                    if (ctx.mesh.occludedBlocks(leaf, numBlocks, ctx.ray, ctx.tmin,
+                                                ctx.hit.getT())) {
+                        Stats::count(Stats::OctreeNodes, visited);
+                        Stats::count(Stats::TriangleTests, tested * TriangleBlock::kSize);
+                        return true;
+                    }
+                } else if (ctx.mesh.intersectBlocks(leaf, numBlocks, ctx.ray, ctx.tmin,
+                                                    ctx.hit)) {
+                    intersected = true;
+                }
+            } else {
+                assert(sp < kStackSize);
+                Frame &f = stack[sp++];
+                f.node = node;
+                for (int dim = 0; dim < 3; dim++) {
+                    f.t0[dim] = t0[dim];
+                    f.t1[dim] = t1[dim];
+                    f.tm[dim] = mid_t(t0[dim], t1[dim], rd[dim], ro[dim], lo[dim], hi[dim]);
+                    f.lo[dim] = lo[dim];
+                    f.hi[dim] = hi[dim];
+                }
+                f.next = first_node(t0[0], t0[1], t0[2], f.tm[0], f.tm[1], f.tm[2]);
+            }
+        }
 
-    float txm = 0.5f * (tx0 + tx1);
-    float tym = 0.5f * (ty0 + ty1);  
-    float tzm = 0.5f * (tz0 + tz1);  
-    int currNode = first_node(tx0, ty0, tz0, txm, tym, tzm);
-    do {
-        switch (currNode) {
-        case 0: {
-            bool result = proc_subtree(tx0, ty0, tz0, txm, tym, tzm, node->child[aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 4, tym, 2, tzm, 1);
-        } break;
-        case 1: {
-            bool result = proc_subtree(tx0, ty0, tzm, txm, tym, tz1, node->child[1^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 5, tym, 3, tz1, 8);
-        } break;
-        case 2: {
-            bool result = proc_subtree(tx0, tym, tz0, txm, ty1, tzm, node->child[2^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 6, ty1, 8, tzm, 3);
-        } break;
-        case 3: {
-            bool result = proc_subtree(tx0, tym, tzm, txm, ty1, tz1, node->child[3^aa],ray);
-            intersected |= result;
-            currNode = new_node(txm, 7, ty1, 8, tz1, 8);
-        } break;
-        case 4: {
-            bool result = proc_subtree(txm, ty0, tz0, tx1, tym, tzm, node->child[4^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, tym, 6, tzm, 5);
-        } break;
-        case 5: {
-            bool result = proc_subtree(txm, ty0, tzm, tx1, tym, tz1, node->child[5^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, tym, 7, tz1, 8);
-        } break;
-        case 6: {
-            bool result = proc_subtree(txm, tym, tz0, tx1, ty1, tzm, node->child[6^aa],ray);
-            intersected |= result;
-            currNode = new_node(tx1, 8, ty1, 8, tzm, 7);
-        } break;
-        case 7: {
-            bool result = proc_subtree(txm, tym, tzm, tx1, ty1, tz1, node->child[7^aa],ray);
-            intersected |= result;
-            currNode = 8;
-        } break;
+        // advance to the next child of the innermost unfinished node
+        while (sp > 0 && stack[sp - 1].next >= 8) {
+            sp--;
+        }
+        if (sp == 0) {
+            break;
+        }
+        Frame &f = stack[sp - 1];
+        int c = f.next;
+        for (int dim = 0; dim < 3; dim++) {
+            float mid = 0.5f * (f.lo[dim] + f.hi[dim]);
+            bool upper = (c & (4 >> dim)) != 0;
+            t0[dim] = upper ? f.tm[dim] : f.t0[dim];
+            t1[dim] = upper ? f.t1[dim] : f.tm[dim];
+            lo[dim] = upper ? mid : f.lo[dim];
+            hi[dim] = upper ? f.hi[dim] : mid;
         }
-    } while (currNode < 8);
+        f.next = new_node(t1[0], (c & 4) ? 8 : (c | 4),
+                          t1[1], (c & 2) ? 8 : (c | 2),
+                          t1[2], (c & 1) ? 8 : (c | 1));
+        node = &nodes[f.node->offset + (c ^ ctx.mirror)];
+    }
 
+    Stats::count(Stats::OctreeNodes, visited);
+    Stats::count(Stats::TriangleTests, tested * TriangleBlock::kSize);
     return intersected;
 }
 
 bool
-Octree::intersect(const Ray &ray)
+Octree::occluded(TraversalContext &ctx) const
+{
+    ctx.anyHit = true;
+    return intersect(ctx);
+}
+
+bool
+Octree::intersect(TraversalContext &ctx) const
 {
-    Vector3f rd = ray.getDirection();
+    if (nodes.empty()) {
+        return false;
+    }
+
+    const Ray &ray = ctx.ray;
+    Vector3f dir = ray.getDirection();
 
     //assumes rd normalized
-    rd.normalize();
-    Vector3f ro = ray.getOrigin();
-
-    aa = 0;
-    Vector3f size = box.mx + box.mn;
-    if (rd[0]<0.0f) {
-        ro[0] = size[0] - ro[0];
-        rd[0] = - rd[0];
-        aa |= 4 ; 
+    dir.normalize();
+    const Vector3f orig = ray.getOrigin();
+    float rd[3], ro[3];
+    for (int dim = 0; dim < 3; dim++) {
+        rd[dim] = dir[dim];
+        ro[dim] = orig[dim];
     }
-    if (rd[1] < 0.0f) {
-        ro[1] = size[1] - ro[1];
-        rd[1] = - rd[1];
-        aa |= 2 ;
+
+    // mirror the ray into the positive octant
+    ctx.mirror = 0;
+    for (int dim = 0; dim < 3; dim++) {
+        if (rd[dim] < 0.0f) {
+            ro[dim] = (box.mx[dim] + box.mn[dim]) - ro[dim];
+            rd[dim] = - rd[dim];
+            ctx.mirror |= 4 >> dim;
+        }
     }
-    if (rd[2] < 0.0f) {
-        ro[2] = size[2] - ro[2];
-        rd[2] = - rd[2];
-        aa |= 1 ;
+
+    // 1 / 0 would turn the slab bounds into NaN (origin on a face) or
+    // flip them (-0), so a ray parallel to a slab gets its bounds directly:
+    // it stays inside for every t or misses the box.
+    float t0[3], t1[3];
+    for (int dim = 0; dim < 3; dim++) {
+        if (rd[dim] == 0) {
+            bool inside = ro[dim] >= box.mn[dim] && ro[dim] <= box.mx[dim];
+            t0[dim] = inside ? -std::numeric_limits<float>::infinity()
+                             : std::numeric_limits<float>::infinity();
+            t1[dim] = -t0[dim];
+        } else {
+            float div = 1 / rd[dim];
+            t0[dim] = (box.mn[dim] - ro[dim]) * div;
+            t1[dim] = (box.mx[dim] - ro[dim]) * div;
+        }
     }
 
-#if 0
-    float divx = 1 / (0.000001f+rd[0]); // IEEE stability fix
-    float divy = 1 / (0.000001f+rd[1]);
-    float divz = 1 / (0.000001f+rd[2]);
-#else
-    float divx = 1 / rd[0]; // IEEE stability fix
-    float divy = 1 / rd[1];
-    float divz = 1 / rd[2];
-#endif
-
-    float tx0 = (box.mn[0] - ro[0]) * divx;
-    float tx1 = (box.mx[0] - ro[0]) * divx;
-    float ty0 = (box.mn[1] - ro[1]) * divy;
-    float ty1 = (box.mx[1] - ro[1]) * divy;
-    float tz0 = (box.mn[2] - ro[2]) * divz;
-    float tz1 = (box.mx[2] - ro[2]) * divz;
-
-    if (std::max(std::max(tx0,ty0), tz0) <= std::min(std::min(tx1, ty1), tz1)) {
-        return proc_subtree(tx0, ty0, tz0, tx1, ty1, tz1, &root, ray);
+    if (std::max(std::max(t0[0], t0[1]), t0[2]) <= std::min(std::min(t1[0], t1[1]), t1[2])) {
+        return traverse(ro, rd, t0, t1, ctx);
     } else {
         return false;
     }
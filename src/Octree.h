@@ -1,48 +1,34 @@
 #ifndef OCTREE_HPP
 #define OCTREE_HPP
+#include <cassert>
 #include <cstdint>
 
-class Mesh;
-
-struct Box
-{
-    Vector3f mn, mx;
+#include "Box.h"
+#include "Buffer.h"
+#include "Traversal.h"
+#include "TriangleBlock.h"
 
-    Box() {}
+#include <vector>
 
-    Box(const Vector3f &a, const Vector3f &b) :
-        mn(a),
-        mx(b)
-    {}
-
-    Box(float mnx, float mny, float mnz,
-        float mxx, float mxy, float mxz) :
-        mn(Vector3f(mnx, mny, mnz)),
-        mx(Vector3f(mxx, mxy, mxz))
-    {}
-};
+class Mesh;
+class ThreadPool;
 
+// Node of a flattened octree. The 8 children of an inner node are
+// consecutive in the node array; the triangles of a leaf are a range of
+// the shared block array. Nothing points anywhere, so the arrays can be
+// written to a file and mapped back as they are.
 struct OctNode
 {
-    OctNode *child[8];
+    // count of an inner node
+    static const uint32_t kInner = 0xffffffff;
 
-    OctNode() {
-        for (int i = 0; i < 8; ++i) {
-            child[i] = nullptr;
-        }
-    }
-    ~OctNode() {
-        for (int i = 0; i < 8; ++i) {
-            delete child[i];
-        }
-    }
+    uint32_t offset;  // 内部节点: 第一个子节点的下标; 叶节点: 第一个块的下标
+    uint32_t count;   // 叶节点的块数, 内部节点为 kInner
 
     ///@brief is this terminal
-    bool isTerm() {
-        return child[0] == nullptr;
+    bool isTerm() const {
+        return count != kInner;
     }
-
-    std::vector<int> obj;
 };
 
 class Octree
@@ -51,32 +37,75 @@ class Octree
     Octree(int level = 8) :
         maxLevel(level)
     {
+        assert(maxLevel + 2 <= kStackSize);
+    }
+
+    // With a pool the children of large nodes are built as parallel
+    // tasks; the tree is the same for any number of threads.
+    void build(const Mesh &m, ThreadPool *pool = nullptr);
+
+    // Uses nodes and blocks stored elsewhere, e.g. in a mapped cache file,
+    // instead of building them. Nothing is copied, so the memory must
+    // outlive the octree.
+    void view(const Box &bounds, const OctNode *nodes, size_t numNodes,
+              const TriangleBlock *blocks, size_t numBlocks);
+
+    const Box &getBounds() const {
+        return box;
+    }
+
+    // root first
+    const Buffer<OctNode> &getNodes() const {
+        return nodes;
     }
 
-    void build(Mesh *m);
+    const Buffer<TriangleBlock> &getBlocks() const {
+        return blocks;
+    }
+
+    // all per-ray state lives in ctx, so concurrent calls are safe
+    bool intersect(TraversalContext &ctx) const;
 
-    bool intersect(const Ray &ray);
+    // stops at the first triangle closer than ctx.hit.getT()
+    bool occluded(TraversalContext &ctx) const;
 
   private:
-    void buildNode(OctNode *parent, 
+    // trigBoxes holds the bounding box of every triangle of m
+    void buildNode(std::vector<OctNode> &outNodes,
+                   std::vector<int> &outTrigs,
+                   uint32_t index,
                    const Box &pbox,
                    const std::vector<int> &trigs, 
                    const Mesh &m, 
-                   int level);
+                   const std::vector<Box> &trigBoxes,
+                   ThreadPool *pool,
+                   int level) const;
 
-    bool proc_subtree(float tx0, float ty0, float tz0, 
-                      float tx1, float ty1, float tz1, 
-                      OctNode *node, const Ray &r);
+    // Iterative front-to-back traversal (Revelles et al.) of the ray
+    // mirrored into the positive octant; rootT0/rootT1 are its slab
+    // parameters at the root box
+    bool traverse(const float *ro, const float *rd,
+                  const float *rootT0, const float *rootT1,
+                  TraversalContext &ctx) const;
 
     // if a node contains more than 7 triangles and it 
     // hasn't reached the max level yet, split
     static const int max_trig = 7;
 
+    // nodes with at least this many triangles build their children as tasks
+    static const int kParallelBuildSize = 4096;
+
+    // traversal keeps one frame per level; leaves sit at most
+    // maxLevel + 2 levels deep
+    static const int kStackSize = 32;
+
+    // relative slack when comparing node entry parameters with Hit::t
+    static constexpr float kEntryMargin = 1e-4f;
+
     int maxLevel;
-    Mesh *mesh;
     Box box;
-    OctNode root;
-    uint8_t aa;
+    Buffer<OctNode> nodes;
+    Buffer<TriangleBlock> blocks;  // 所有叶节点中的三角形, 按叶节点顺序
 };
 
 #endif
@@ -0,0 +1,58 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+#include <limits>
+
+// Small PCG32 generator usable with the <random> distributions.
+// Cheap enough to seed once per pixel, so every pixel gets its own
+// deterministic stream no matter which thread renders it.
+class Rng {
+   public:
+    typedef uint32_t result_type;
+
+    explicit Rng(uint64_t seed = 0, uint64_t stream = 0) {
+        _state = 0;
+        _inc = (stream << 1u) | 1u;
+        (*this)();
+        _state += seed;
+        (*this)();
+    }
+
+    // 以像素坐标为种子的随机数流
+    static Rng forPixel(int x, int y, uint64_t stream = 0) {
+        return Rng(((uint64_t)(uint32_t)y << 32) | (uint32_t)x, stream);
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+
+    result_type operator()() {
+        uint64_t old = _state;
+        _state = old * 6364136223846793005ULL + _inc;
+        uint32_t xorshifted = (uint32_t)(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = (uint32_t)(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    // Skips the next delta outputs in O(log delta) steps.
+    void advance(uint64_t delta) {
+        uint64_t mult = 6364136223846793005ULL, plus = _inc;
+        uint64_t accMult = 1, accPlus = 0;
+        for (; delta; delta >>= 1) {
+            if (delta & 1) {
+                accMult *= mult;
+                accPlus = accPlus * mult + plus;
+            }
+            plus = (mult + 1) * plus;
+            mult *= mult;
+        }
+        _state = accMult * _state + accPlus;
+    }
+
+   private:
+    uint64_t _state;
+    uint64_t _inc;
+};
+
+#endif  // RANDOM_H
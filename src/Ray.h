@@ -52,13 +52,15 @@ class Hit
 public:
     // Constructors
     Hit() : material(NULL),
-            t(std::numeric_limits<float>::max())
+            t(std::numeric_limits<float>::max()),
+            object(-1)
     {
     }
 
     Hit(float argt, Material *argmaterial, const Vector3f &argnormal) : t(argt),
                                                                         material(argmaterial),
-                                                                        normal(argnormal)
+                                                                        normal(argnormal),
+                                                                        object(-1)
     {
     }
 
@@ -88,6 +90,7 @@ public:
     float t; // 光线传播的距离
     Material *material; // 交点的材质
     Vector3f normal; // 交点处的法向量
+    int object; // 命中物体在场景顶层 Group 中的下标, 由 Group 填写, -1 表示未知
 };
 
 inline std::ostream &
@@ -0,0 +1,87 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "Ray.h"
+
+// Four coherent rays (e.g. a 2x2 block of camera rays) in SoA layout,
+// traced together by the packet kernels.
+// Lanes are addressed with bit masks: bit i stands for ray i.
+struct RayPacket
+{
+    static const int kSize = 4;
+    static const int kAllLanes = (1 << kSize) - 1;
+
+    float ox[kSize], oy[kSize], oz[kSize];  // 光线起点
+    float dx[kSize], dy[kSize], dz[kSize];  // 光线方向
+    float ix[kSize], iy[kSize], iz[kSize];  // 方向的倒数, 用于包围盒测试
+
+    void set(int i, const Ray &r)
+    {
+        const Vector3f o = r.getOrigin();
+        const Vector3f d = r.getDirection();
+        ox[i] = o[0];
+        oy[i] = o[1];
+        oz[i] = o[2];
+        dx[i] = d[0];
+        dy[i] = d[1];
+        dz[i] = d[2];
+        ix[i] = 1.0f / d[0];
+        iy[i] = 1.0f / d[1];
+        iz[i] = 1.0f / d[2];
+    }
+
+    Ray getRay(int i) const
+    {
+        return Ray(Vector3f(ox[i], oy[i], oz[i]), Vector3f(dx[i], dy[i], dz[i]));
+    }
+
+    // Copies the first lane of mask into the lanes outside it. The kernels
+    // load all four lanes, so unused lanes must hold a valid ray, not
+    // uninitialized floats (possibly denormals or NaNs).
+    void fillInactive(int mask)
+    {
+        int src = 0;
+        while (src < kSize && !(mask & (1 << src))) {
+            src++;
+        }
+        if (src == kSize) {
+            return;
+        }
+        for (int i = 0; i < kSize; i++) {
+            if (mask & (1 << i)) {
+                continue;
+            }
+            ox[i] = ox[src];
+            oy[i] = oy[src];
+            oz[i] = oz[src];
+            dx[i] = dx[src];
+            dy[i] = dy[src];
+            dz[i] = dz[src];
+            ix[i] = ix[src];
+            iy[i] = iy[src];
+            iz[i] = iz[src];
+        }
+    }
+};
+
+// index of the lowest lane set in mask
+inline int firstLane(int mask)
+{
+    int i = 0;
+    while (!(mask & (1 << i))) {
+        i++;
+    }
+    return i;
+}
+
+// number of lanes set in mask
+inline int numLanes(int mask)
+{
+    int n = 0;
+    for (; mask; mask &= mask - 1) {
+        n++;
+    }
+    return n;
+}
+
+#endif // RAY_PACKET_H
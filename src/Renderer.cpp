@@ -2,141 +2,691 @@
 
 #include "ArgParser.h"
 #include "Camera.h"
+#include "Checkpoint.h"
+#include "Filter.h"
 #include "Image.h"
 #include "Ray.h"
+#include "Random.h"
+#include "RayPacket.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 #include "VecUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <sstream>
+#include <vector>
 
-Renderer::Renderer(const ArgParser& args) : _args(args), _scene(args.input_file) {}
+namespace {
+
+MeshOptions meshOptions(const ArgParser& args, ThreadPool* pool) {
+    MeshOptions options;
+    options.pool = pool;
+    options.threads = args.threads;
+    options.cache = args.mesh_cache;
+    options.cacheDir = args.cache_dir;
+    return options;
+}
+
+// 俄罗斯轮盘赌所用随机数流的起点, 每个采样一个流
+const uint64_t kRouletteStream = 1;
+
+// 自适应采样时与相邻像素颜色相差超过此值的像素在首轮后继续采样
+const float kContrastThreshold = 0.05f;
+
+float maxComponent(const Vector3f& v) {
+    return std::max(v[0], std::max(v[1], v[2]));
+}
+
+Vector3f clampColor(const Vector3f& c) {
+    return Vector3f(std::min(std::max(c[0], 0.0f), 1.0f), std::min(std::max(c[1], 0.0f), 1.0f),
+                    std::min(std::max(c[2], 0.0f), 1.0f));
+}
+
+// 一个像素已取得的采样
+struct PixelEstimate {
+    Vector3f sum;        // 采样颜色之和
+    Vector3f clampedSum; // 截断到 [0,1] 后的颜色之和
+    Vector3f clampedSq;  // 截断后颜色的平方和
+    int count = 0;       // 采样数
+
+    void add(const Vector3f& c) {
+        sum += c;
+        Vector3f v = clampColor(c);
+        clampedSum += v;
+        clampedSq += v * v;
+        count++;
+    }
+
+    Vector3f mean() const {
+        return clampedSum / count;
+    }
+
+    // Largest standard error of the mean over the channels, computed on
+    // the colours as they are written to the image.
+    float error() const {
+        if (count < 2)
+            return std::numeric_limits<float>::infinity();
+        Vector3f var = (clampedSq - clampedSum * clampedSum / count) / (count - 1);
+        return std::sqrt(std::max(maxComponent(var), 0.0f) / count);
+    }
+};
+
+// Everything besides the size and the pass count that the pixels of a
+// progressive render depend on; a checkpoint is only resumed with the
+// same settings.
+std::string progressiveSettings(const ArgParser& args) {
+    std::ostringstream s;
+    s << "input=" << args.input_file << " bounces=" << args.bounces
+      << " roulette=" << args.roulette << " shadows=" << args.shadows
+      << " filter=" << (args.filter ? (int)args.filter_kernel : -1);
+    return s.str();
+}
+
+// 物体编号对应的颜色, 相邻编号的颜色相差较大
+Vector3f idColor(int id) {
+    uint32_t v = (uint32_t)(id + 1) * 2654435761u;
+    return Vector3f((v >> 24) & 255, (v >> 16) & 255, (v >> 8) & 255) / 255.0f;
+}
+
+}  // namespace
+
+// 一个待追踪的主光线采样
+struct Renderer::Sample {
+    Ray ray;
+    int pixel;  // 所属像素在图块内的下标
+    Rng rng;    // 俄罗斯轮盘赌的随机数流
+};
+
+// 渲染进度, 每完成 1% 的图块打印一次
+struct Renderer::Progress {
+    explicit Progress(int total) : numTiles(total), tilesDone(0) {}
+
+    int numTiles;
+    std::atomic<int> tilesDone;
+    std::mutex logMutex;
+};
+
+Renderer::Renderer(const ArgParser& args, AssetCache* assets, ThreadPool* pool)
+    : _args(args),
+      _ownPool(pool ? nullptr : new ThreadPool(args.threads)),
+      _pool(pool ? pool : _ownPool.get()),
+      _scene(args.input_file, args.accel, meshOptions(args, _pool), assets) {
+    addAov(Normals, args.normals_file);
+    addAov(Depth, args.depth_file);
+    addAov(Albedo, args.albedo_file);
+    addAov(ObjectId, args.ids_file);
+}
+
+Renderer::~Renderer() {}
+
+void Renderer::addAov(Aov aov, const std::string& filename) {
+    _aovFiles[aov] = filename;
+}
 
 // 主体渲染循环
 void Renderer::Render() {
-    int w = _args.width;
-    int h = _args.height;
+    const int w = _args.width;
+    const int h = _args.height;
+
+    // AOV 图只在需要输出时分配
+    Image image(w, h);
+    Image aovImages[NumAovs];
+    Film film = {&image, {}, 0};
+    for (int a = 0; a < NumAovs; a++)
+        if (!_aovFiles[a].empty()) {
+            aovImages[a] = Image(w, h);
+            film.aovs[a] = &aovImages[a];
+        }
 
-    // 高斯滤波
-    if (_args.filter == true) {
-        const int k = 3;
-        w *= k;
-        h *= k;
+    // 将图片划分为 kTileSize x kTileSize 的图块, 交给线程池并行渲染;
+    // 滤波时按子采样的行带逐带渲染
+    const int scale = _args.filter ? kFilterScale : 1;
+    const int rows = _args.filter ? filterBandRows() : kTileSize;
+    const int tilesX = (w * scale + kTileSize - 1) / kTileSize;
+    const int tilesY = (h * scale + rows - 1) / rows;
+    Progress progress(tilesX * tilesY * std::max(_args.progressive, 1));
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool& pool = *_pool;
+    std::cerr << "Rendering " << progress.numTiles << " tiles on " << pool.getNumThreads()
+              << " threads" << std::endl;
+    long long primaryRays;
+    {
+        Stats::Timer timer(Stats::Render);
+        if (_args.progressive > 0)
+            primaryRays = renderProgressive(pool, film, progress);
+        else if (_args.filter)
+            primaryRays = renderFiltered(pool, film, progress, -1);
+        else
+            primaryRays = renderRows(pool, 0, h, w, h, film, progress, -1);
     }
 
-    Image image(w, h);
-    Image nimage(w, h);
-    Image dimage(w, h);
+    // 报告渲染耗时与主光线吞吐量
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Rendered " << primaryRays << " primary rays in " << elapsed.count() << " s ("
+              << primaryRays / elapsed.count() / 1e6 << " Mrays/s)" << std::endl;
 
-    // 随机数生成器[-1,1]
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
-    Camera* cam = _scene.getCamera();  // 获取相机配置
-    for (int y = 0; y < h; y++)        // 遍历图片的高度像素 [0,h)
     {
-        std::cerr << "Rendering row " << y << " of " << h << std::endl;
-        for (int x = 0; x < w; x++) {
-            Hit hit;         // 当前光线的交点属性
-            Vector3f color;  // 当前像素的颜色
-            if (_args.jitter == false) {
-                float ndcy = 2 * (y / (h - 1.0f)) - 1.0f;        // 标准化y坐标 [-1,1]
-                float ndcx = 2 * (x / (w - 1.0f)) - 1.0f;        // 标准化x坐标 [-1,1]
-                Ray r = cam->generateRay(Vector2f(ndcx, ndcy));  // 当前图片像素对应的光线
-                color = traceRay(r, cam->getTMin(), _args.bounces, hit);
+        Stats::Timer timer(Stats::Write);
+        if (_args.output_file.size())
+            image.savePNG(_args.output_file);
+        for (int a = 0; a < NumAovs; a++)
+            if (film.aovs[a])
+                film.aovs[a]->savePNG(_aovFiles[a]);
+    }
+
+    if (_args.stats)
+        Stats::report(std::cout);
+}
+
+int Renderer::filterBandRows() const {
+    return std::max(1, kTileSize / kFilterScale) * kFilterScale;
+}
+
+long long Renderer::renderRows(ThreadPool& pool, int y0, int y1, int w, int h, const Film& film,
+                               Progress& progress, int pass) const {
+    const int tilesX = (w + kTileSize - 1) / kTileSize;
+    const int tilesY = (y1 - y0 + kTileSize - 1) / kTileSize;
+    std::atomic<long long> primaryRays(0);
+    pool.parallelFor(tilesX * tilesY, [&](int tile) {
+        int x0 = (tile % tilesX) * kTileSize;
+        int ty0 = y0 + (tile / tilesX) * kTileSize;
+        int x1 = std::min(x0 + kTileSize, w);
+        int ty1 = std::min(ty0 + kTileSize, y1);
+        long long rays;
+        if (pass >= 0 || _args.wavefront || _args.adaptive > 0) {
+            rays = renderTile(x0, ty0, x1, ty1, w, h, film, pass);
+        } else {
+            if (_args.packets && !_args.jitter) {
+                // 2x2 像素的主光线组成一个光线包
+                for (int y = ty0; y < ty1; y += 2)
+                    for (int x = x0; x < x1; x += 2)
+                        renderQuad(x, y, x1, ty1, w, h, film);
             } else {
-                // 抖动采样
-                int num_samples = 16;
-                for (int i = 0; i < num_samples; i++) {
-                    hit = {};
-                    float ndcy = 2 * ((y + dis(gen)) / (h - 1.0f)) - 1.0f;  // 抖动
-                    float ndcx = 2 * ((x + dis(gen)) / (w - 1.0f)) - 1.0f;  // 抖动
-                    Ray r = cam->generateRay(Vector2f(ndcx, ndcy));
-                    color += traceRay(r, cam->getTMin(), _args.bounces, hit);
+                for (int y = ty0; y < ty1; y++)
+                    for (int x = x0; x < x1; x++)
+                        renderPixel(x, y, w, h, film);
+            }
+            rays = (long long)(x1 - x0) * (ty1 - ty0) * (_args.jitter ? _args.max_samples : 1);
+        }
+        primaryRays += rays;
+        Stats::count(Stats::PrimaryRays, rays);
+        Stats::flush();
+
+        int done = ++progress.tilesDone;
+        if (done * 100 / progress.numTiles != (done - 1) * 100 / progress.numTiles) {
+            std::lock_guard<std::mutex> lock(progress.logMutex);
+            std::cerr << "Rendered " << done << " of " << progress.numTiles << " tiles" << std::endl;
+        }
+    });
+    return primaryRays;
+}
+
+long long Renderer::renderFiltered(ThreadPool& pool, const Film& film, Progress& progress,
+                                   int pass) const {
+    const int w = _args.width, h = _args.height;
+    const int k = kFilterScale;
+    const int sw = w * k, sh = h * k;  // 子采样的分辨率
+    int first;
+    std::vector<float> taps;
+    Filter(_args.filter_kernel).taps(k, first, taps);
+    const int numTaps = (int)taps.size();
+
+    // Subsamples are rendered band by band into these buffers, which hold
+    // one band of rows. Every subsample row is filtered horizontally right
+    // away into a ring of rows at output width; an output row is filtered
+    // vertically once all of its rows are in the ring.
+    const int bandRows = filterBandRows();
+    Image samples(sw, bandRows);
+    Image bandAovs[NumAovs];
+    Film band = {&samples, {}, 0};
+    for (int a = 0; a < NumAovs; a++)
+        if (film.aovs[a]) {
+            bandAovs[a] = Image(sw, bandRows);
+            band.aovs[a] = &bandAovs[a];
+        }
+    const int ringRows = bandRows + numTaps;
+    std::vector<Vector3f> ring((size_t)ringRows * w);
+
+    long long primaryRays = 0;
+    int nextRow = 0;  // 下一个待输出的行
+    for (int sy0 = 0; sy0 < sh; sy0 += bandRows) {
+        const int sy1 = std::min(sy0 + bandRows, sh);
+        band.y0 = sy0;
+        primaryRays += renderRows(pool, sy0, sy1, sw, sh, band, progress, pass);
+
+        Stats::Timer timer(Stats::Filter);
+        pool.parallelFor(sy1 - sy0, [&](int row) {
+            Vector3f* out = &ring[(size_t)((sy0 + row) % ringRows) * w];
+            for (int x = 0; x < w; x++) {
+                Vector3f sum;
+                float weight = 0;
+                for (int i = 0; i < numTaps; i++) {
+                    int sx = k * x + first + i;
+                    if (sx < 0 || sx >= sw)
+                        continue;
+                    sum += taps[i] * samples.getPixel(sx, row);
+                    weight += taps[i];
                 }
-                color = color / num_samples;
+                out[x] = sum / weight;
             }
+        });
 
-            image.setPixel(x, y, color);
-            nimage.setPixel(x, y, (hit.getNormal() + 1.0f) / 2.0f);
-            float range = (_args.depth_max - _args.depth_min);
-            if (range)
-                dimage.setPixel(x, y, Vector3f((hit.t - _args.depth_min) / range));
+        // AOV 取离像素中心最近的子采样
+        for (int a = 0; a < NumAovs; a++) {
+            if (!film.aovs[a])
+                continue;
+            for (int y = (sy0 + k - 1 - k / 2) / k; y < h && k * y + k / 2 < sy1; y++)
+                for (int x = 0; x < w; x++)
+                    film.aovs[a]->setPixel(x, y, bandAovs[a].getPixel(k * x + k / 2, k * y + k / 2 - sy0));
         }
+
+        int lastRow = nextRow;
+        while (lastRow < h && std::min(k * lastRow + first + numTaps, sh) <= sy1)
+            lastRow++;
+        pool.parallelFor(lastRow - nextRow, [&](int i) {
+            const int y = nextRow + i;
+            for (int x = 0; x < w; x++) {
+                Vector3f sum;
+                float weight = 0;
+                for (int j = 0; j < numTaps; j++) {
+                    int sy = k * y + first + j;
+                    if (sy < 0 || sy >= sh)
+                        continue;
+                    sum += taps[j] * ring[(size_t)(sy % ringRows) * w + x];
+                    weight += taps[j];
+                }
+                film.image->setPixel(x, y, sum / weight);
+            }
+        });
+        nextRow = lastRow;
     }
+    return primaryRays;
+}
 
-    if (_args.output_file.size()) {
-        if (_args.filter == false)
-            image.savePNG(_args.output_file);
-        else {
-            // 高斯滤波
-            Image output(_args.width, _args.height);
-            float ker[3][3] = {{1, 2, 1}, {2, 4, 2}, {1, 2, 1}};
-            for (int y = 0; y < _args.height; y++) {
-                for (int x = 0; x < _args.width; x++) {
-                    Vector3f color = {0, 0, 0};
-                    for (int i = -1; i <= 1; i++)
-                        for (int j = -1; j <= 1; j++) {
-                            int x_pos = x * 3 + i, y_pos = y * 3 + j;
-                            // 如果超出边界, 则跳过此次计算
-                            if (x_pos < 0 || x_pos >= w || y_pos < 0 || y_pos >= h)
-                                continue;
-                            color += image.getPixel(x_pos, y_pos) * ker[i + 1][j + 1];
-                        }
-                    output.setPixel(x, y, color / 16.0f);
+long long Renderer::renderProgressive(ThreadPool& pool, const Film& film,
+                                      Progress& progress) const {
+    const int w = _args.width, h = _args.height;
+    const int passes = _args.progressive;
+    const std::string settings = progressiveSettings(_args);
+    std::vector<Vector3f> sums((size_t)w * h);
+    int done = 0;  // 已累加的遍数
+    if (!_args.checkpoint_file.empty() &&
+        Checkpoint::load(_args.checkpoint_file, settings, w, h, done, sums)) {
+        std::cerr << "Resuming " << _args.checkpoint_file << " after " << done << " of "
+                  << passes << " passes" << std::endl;
+        progress.tilesDone = progress.numTiles / passes * std::min(done, passes);
+    }
+
+    // 每一遍先渲染到 passImage, 再累加到 sums; AOV 取最后一遍的结果
+    Image passImage(w, h);
+    Film passFilm = film;
+    passFilm.image = &passImage;
+    long long primaryRays = 0;
+    auto lastWrite = std::chrono::steady_clock::now();
+    int lastWritePasses = done;
+    while (done < passes) {
+        primaryRays += _args.filter ? renderFiltered(pool, passFilm, progress, done)
+                                    : renderRows(pool, 0, h, w, h, passFilm, progress, done);
+        for (int y = 0; y < h; y++)
+            for (int x = 0; x < w; x++)
+                sums[(size_t)y * w + x] += passImage.getPixel(x, y);
+        done++;
+
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::duration<double> sinceWrite = now - lastWrite;
+        if (done < passes && (sinceWrite.count() >= _args.write_interval ||
+                              (_args.write_passes > 0 && done - lastWritePasses >= _args.write_passes))) {
+            Stats::Timer timer(Stats::Write);
+            writeProgress(film, sums, done);
+            if (_args.output_file.size())
+                film.image->savePNG(_args.output_file);
+            std::cerr << "Wrote pass " << done << " of " << passes << std::endl;
+            lastWrite = now;
+            lastWritePasses = done;
+        }
+    }
+    writeProgress(film, sums, done);
+    return primaryRays;
+}
+
+void Renderer::writeProgress(const Film& film, const std::vector<Vector3f>& sums,
+                             int passes) const {
+    Stats::Timer timer(Stats::Write);
+    const int w = _args.width, h = _args.height;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            film.image->setPixel(x, y, passes ? sums[(size_t)y * w + x] / passes : Vector3f(0.0f));
+    if (!_args.checkpoint_file.empty() &&
+        !Checkpoint::save(_args.checkpoint_file, progressiveSettings(_args), w, h, passes, sums))
+        std::cerr << "Cannot write checkpoint " << _args.checkpoint_file << std::endl;
+}
+
+// 渲染单个像素, 写入颜色/法线/深度图
+void Renderer::renderPixel(int x, int y, int w, int h, const Film& film) const {
+    const Camera* cam = _scene.getCamera();  // 获取相机配置
+    Hit hit;         // 当前光线的交点属性
+    Vector3f color;  // 当前像素的颜色
+    if (_args.jitter == false) {
+        Ray r = primaryRay((float)x, (float)y, w, h);  // 当前图片像素对应的光线
+        Rng rng = Rng::forPixel(x, y, kRouletteStream);
+        color = traceRay(r, cam->getTMin(), _args.bounces, hit, rng);
+    } else {
+        // 抖动采样, 每个像素使用独立的随机数流 [-1,1], 结果与线程数无关
+        Rng gen = Rng::forPixel(x, y);
+        std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+        int num_samples = _args.max_samples;
+        for (int i = 0; i < num_samples; i++) {
+            hit = {};
+            float py = y + dis(gen);  // 抖动
+            float px = x + dis(gen);  // 抖动
+            Ray r = primaryRay(px, py, w, h);
+            Rng rng = Rng::forPixel(x, y, kRouletteStream + i);
+            color += traceRay(r, cam->getTMin(), _args.bounces, hit, rng);
+        }
+        color = color / num_samples;
+    }
+
+    storePixel(x, y, color, hit, film);
+}
+
+// 以光线包渲染 (x,y) 起的 2x2 像素块, 超出 [x1,y1) 的像素不渲染
+void Renderer::renderQuad(int x, int y, int x1, int y1, int w, int h, const Film& film) const {
+    const Camera* cam = _scene.getCamera();
+    RayPacket rays;
+    Hit hits[RayPacket::kSize];
+    int mask = 0;
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        int px = x + (i & 1), py = y + (i >> 1);
+        if (px >= x1 || py >= y1)
+            continue;
+        rays.set(i, primaryRay((float)px, (float)py, w, h));
+        mask |= 1 << i;
+    }
+    rays.fillInactive(mask);
+
+    int hitMask = _scene.getGroup()->intersectPacket(rays, mask, cam->getTMin(), hits);
+    for (int i = 0; i < RayPacket::kSize; i++) {
+        if (!(mask & (1 << i)))
+            continue;
+        Ray r = rays.getRay(i);
+        Rng rng = Rng::forPixel(x + (i & 1), y + (i >> 1), kRouletteStream);
+        Vector3f color = (hitMask & (1 << i))
+                             ? tracePath(r, cam->getTMin(), _args.bounces, hits[i], rng)
+                             : _scene.getBackgroundColor(r.getDirection());
+        storePixel(x + (i & 1), y + (i >> 1), color, hits[i], film);
+    }
+}
+
+long long Renderer::renderTile(int x0, int y0, int x1, int y1, int w, int h,
+                              const Film& film, int pass) const {
+    const int tileW = x1 - x0;
+    const int numPixels = tileW * (y1 - y0);
+    const bool progressive = pass >= 0;
+    const bool adaptive = !progressive && _args.adaptive > 0;
+    const bool jittered = _args.jitter || adaptive || progressive;
+    const int maxSamples = jittered && !progressive ? _args.max_samples : 1;
+    const int batch = adaptive ? std::min(_args.min_samples, maxSamples) : maxSamples;
+    const int firstSample = progressive ? pass : 0;  // 本次渲染的第一个采样的序号
+
+    // 抖动采样的随机数流与 renderPixel 相同, 采样 i 在两种方式下一致;
+    // 每个采样取两个随机数, 渐进渲染时跳过之前各遍的采样
+    std::vector<Rng> jitter;
+    for (int p = 0; jittered && p < numPixels; p++) {
+        jitter.push_back(Rng::forPixel(x0 + p % tileW, y0 + p / tileW));
+        jitter.back().advance(2 * (uint64_t)firstSample);
+    }
+    std::uniform_real_distribution<float> dis(-1.0f, 1.0f);
+
+    std::vector<PixelEstimate> estimates(numPixels);
+    std::vector<Hit> pixelHits(numPixels);  // 各像素最后一个采样的主光线交点
+    std::vector<int> active(numPixels), next;
+    for (int p = 0; p < numPixels; p++)
+        active[p] = p;
+    std::vector<Sample> samples;
+    std::vector<Vector3f> colors;
+    std::vector<Hit> hits;
+    long long traced = 0;
+    for (int round = 0; !active.empty(); round++) {
+        samples.clear();
+        for (int p : active) {
+            const int x = x0 + p % tileW, y = y0 + p / tileW;
+            const int first = estimates[p].count;
+            const int last = std::min(first + batch, maxSamples);
+            for (int i = first; i < last; i++) {
+                float px = (float)x, py = (float)y;
+                if (jittered) {
+                    py = y + dis(jitter[p]);
+                    px = x + dis(jitter[p]);
+                }
+                Sample sample = {primaryRay(px, py, w, h), p,
+                                 Rng::forPixel(x, y, kRouletteStream + firstSample + i)};
+                samples.push_back(sample);
+            }
+        }
+        colors.resize(samples.size());
+        hits.resize(samples.size());
+        traceSamples(samples, colors.data(), hits.data());
+        traced += samples.size();
+        for (size_t i = 0; i < samples.size(); i++) {
+            estimates[samples[i].pixel].add(colors[i]);
+            pixelHits[samples[i].pixel] = hits[i];
+        }
+        if (!adaptive)
+            break;
+
+        // Refine pixels whose mean is still uncertain. After the first
+        // round also the ones that differ from a neighbour, where a few
+        // samples can all have missed a thin feature.
+        next.clear();
+        for (int p : active) {
+            const PixelEstimate& e = estimates[p];
+            if (e.count >= maxSamples)
+                continue;
+            bool refine = e.error() > _args.adaptive;
+            if (!refine && round == 0) {
+                const int x = p % tileW, y = p / tileW;
+                const int neighbours[4][2] = {{x - 1, y}, {x + 1, y}, {x, y - 1}, {x, y + 1}};
+                for (int k = 0; k < 4 && !refine; k++) {
+                    const int nx = neighbours[k][0], ny = neighbours[k][1];
+                    if (nx < 0 || nx >= tileW || ny < 0 || ny >= y1 - y0)
+                        continue;
+                    Vector3f d = e.mean() - estimates[ny * tileW + nx].mean();
+                    refine = maxComponent(Vector3f(std::fabs(d[0]), std::fabs(d[1]),
+                                                   std::fabs(d[2]))) > kContrastThreshold;
+                }
+            }
+            if (refine)
+                next.push_back(p);
+        }
+        active.swap(next);
+    }
+
+    for (int p = 0; p < numPixels; p++) {
+        const PixelEstimate& e = estimates[p];
+        Vector3f color = jittered ? e.sum / e.count : e.sum;
+        storePixel(x0 + p % tileW, y0 + p / tileW, color, pixelHits[p], film);
+    }
+    return traced;
+}
+
+void Renderer::traceSamples(const std::vector<Sample>& samples, Vector3f* colors,
+                            Hit* hits) const {
+    const float tmin = _scene.getCamera()->getTMin();
+    if (!_args.wavefront) {
+        for (size_t i = 0; i < samples.size(); i++) {
+            Rng rng = samples[i].rng;
+            hits[i] = Hit();
+            colors[i] = traceRay(samples[i].ray, tmin, _args.bounces, hits[i], rng);
+        }
+        return;
+    }
+
+    // 一条尚未结束的路径
+    struct Path {
+        Ray ray;              // 下一段光线
+        Vector3f throughput;  // 路径权重
+        int sample;           // 所属采样的下标
+        Rng rng;
+    };
+
+    std::vector<Path> paths, next;
+    paths.reserve(samples.size());
+    next.reserve(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        Path p = {samples[i].ray, Vector3f(1.0f), (int)i, samples[i].rng};
+        paths.push_back(p);
+        colors[i] = Vector3f(0.0f);
+    }
+
+    for (int depth = 0; !paths.empty(); depth++) {
+        if (depth > 0)
+            Stats::count(Stats::ReflectionRays, paths.size());
+        next.clear();
+        for (size_t begin = 0; begin < paths.size(); begin += RayPacket::kSize) {
+            const int n = (int)std::min(paths.size() - begin, (size_t)RayPacket::kSize);
+            RayPacket rays;
+            Hit packetHits[RayPacket::kSize];
+            for (int i = 0; i < n; i++)
+                rays.set(i, paths[begin + i].ray);
+            rays.fillInactive((1 << n) - 1);
+            int hitMask = _scene.getGroup()->intersectPacket(rays, (1 << n) - 1, tmin, packetHits);
+
+            for (int i = 0; i < n; i++) {
+                Path& p = paths[begin + i];
+                const Hit& hit = packetHits[i];
+                if (depth == 0)
+                    hits[p.sample] = hit;
+                if (!(hitMask & (1 << i))) {
+                    colors[p.sample] += p.throughput * _scene.getBackgroundColor(p.ray.getDirection());
+                    continue;
                 }
+                colors[p.sample] += p.throughput * shade(p.ray, hit);
+                if (nextBounce(p.ray, hit, depth, _args.bounces, p.throughput, p.rng, p.ray))
+                    next.push_back(p);
             }
-            output.savePNG(_args.output_file);
         }
+        paths.swap(next);
+    }
+}
+
+void Renderer::storePixel(int x, int y, const Vector3f& color, const Hit& hit,
+                          const Film& film) const {
+    y -= film.y0;
+    film.image->setPixel(x, y, color);
+    for (int a = 0; a < NumAovs; a++)
+        if (film.aovs[a])
+            film.aovs[a]->setPixel(x, y, aovValue((Aov)a, hit));
+}
+
+Vector3f Renderer::aovValue(Aov aov, const Hit& hit) const {
+    switch (aov) {
+    case Normals:
+        return (hit.getNormal() + 1.0f) / 2.0f;
+    case Depth: {
+        float range = (_args.depth_max - _args.depth_min);
+        return range ? Vector3f((hit.t - _args.depth_min) / range) : Vector3f(0.0f);
+    }
+    case Albedo:
+        return hit.getMaterial() ? hit.getMaterial()->getDiffuseColor() : Vector3f(0.0f);
+    case ObjectId:
+        return hit.object >= 0 ? idColor(hit.object) : Vector3f(0.0f);
+    default:
+        return Vector3f(0.0f);
     }
+}
 
-    if (_args.depth_file.size())
-        dimage.savePNG(_args.depth_file);
-    if (_args.normals_file.size())
-        nimage.savePNG(_args.normals_file);
+Ray Renderer::primaryRay(float px, float py, int w, int h) const {
+    float ndcy = 2 * (py / (h - 1.0f)) - 1.0f;  // 标准化y坐标 [-1,1]
+    float ndcx = 2 * (px / (w - 1.0f)) - 1.0f;  // 标准化x坐标 [-1,1]
+    return _scene.getCamera()->generateRay(Vector2f(ndcx, ndcy));
 }
 
 Vector3f Renderer::traceRay(const Ray& r,  // 当前图片像素对应的光线
                             float tmin,    // 0.001f 偏移距离
-                            int bounces,   // 光追最大递归深度
-                            Hit& h         // 光线的当前交点
+                            int bounces,   // 最大反弹次数
+                            Hit& h,        // 光线的当前交点
+                            Rng& rng       // 俄罗斯轮盘赌的随机数流
 ) const {
     if (_scene.getGroup()->intersect(r, tmin, h))  // 如果与物体有相交
-    {
-        // 场景环境光
-        Vector3f color = _scene.getAmbientLight() * h.getMaterial()->getDiffuseColor();
-        Vector3f p = r.getOrigin() + r.getDirection() * h.getT();
-
-        // 累加各光源对物体表面的光照
-        for (int i = 0; i < _scene.getNumLights(); i++) {
-            Vector3f tolight;                 // 交点到光源的方向
-            Vector3f lightColor;              // 光源发出的颜色
-            float disToLight;                 // 交点到光源的距离
-            auto light = _scene.getLight(i);  // 获取当前光源
-            light->getIllumination(p, tolight, lightColor, disToLight);
-
-            // 测试阴影
-            if (_args.shadows) {
-                Hit h_test;  // 阴影测试交点
-                Ray r_test = {p + tolight * 0.001f, tolight.normalized()};  // 阴影测试光线
-                if (_scene.getGroup()->intersect(r_test, 0, h_test) &&
-                    h_test.getT() < disToLight)
-                    continue;  // 在交点到光源的路径上存在遮挡
-            }
-            color += h.getMaterial()->shade(r, h, tolight, lightColor);
+        return tracePath(r, tmin, bounces, h, rng);
+    else
+        return _scene.getBackgroundColor(r.getDirection());  // 返回背景颜色
+}
+
+// 沿镜面反射方向迭代追踪, 累加每个交点的直接光照乘以路径权重
+Vector3f Renderer::tracePath(const Ray& r, float tmin, int bounces, const Hit& h,
+                             Rng& rng) const {
+    Vector3f color(0.0f);
+    Vector3f throughput(1.0f);
+    Ray ray = r;
+    Hit hit = h;
+    for (int depth = 0;; depth++) {
+        color += throughput * shade(ray, hit);
+        if (!nextBounce(ray, hit, depth, bounces, throughput, rng, ray))
+            break;
+        Stats::count(Stats::ReflectionRays);
+        hit = Hit();
+        if (!_scene.getGroup()->intersect(ray, tmin, hit)) {
+            color += throughput * _scene.getBackgroundColor(ray.getDirection());
+            break;
         }
+    }
+    return color;
+}
 
-        // 递归光线追踪
-        if (bounces > 0) {
-            Vector3f N = h.getNormal().normalized();      // 交点处法向量
-            Vector3f L = -r.getDirection().normalized();  // 交点到视点的方向
-            Vector3f R = (2 * Vector3f::dot(L, N) * N - L).normalized();  // 理想反射矢量
+// 计算光线 r 在交点 h 处的直接光照
+Vector3f Renderer::shade(const Ray& r, const Hit& h) const {
+    // 场景环境光
+    Vector3f color = _scene.getAmbientLight() * h.getMaterial()->getDiffuseColor();
+    Vector3f p = r.getOrigin() + r.getDirection() * h.getT();
 
-            Hit h_ref;
-            Ray r_ref = {p + R * 0.001f, R};
-            color += h.getMaterial()->getSpecularColor() *
-                     traceRay(r_ref, tmin, bounces - 1, h_ref);
+    // 累加各光源对物体表面的光照
+    for (int i = 0; i < _scene.getNumLights(); i++) {
+        Vector3f tolight;                 // 交点到光源的方向
+        Vector3f lightColor;              // 光源发出的颜色
+        float disToLight;                 // 交点到光源的距离
+        auto light = _scene.getLight(i);  // 获取当前光源
+        light->getIllumination(p, tolight, lightColor, disToLight);
+
+        // 测试阴影
+        if (_args.shadows) {
+            Ray r_test = {p + tolight * 0.001f, tolight.normalized()};  // 阴影测试光线
+            Stats::count(Stats::ShadowRays);
+            if (_scene.getGroup()->occluded(r_test, 0, disToLight))
+                continue;  // 在交点到光源的路径上存在遮挡
         }
-        return color;
-    } else
-        return _scene.getBackgroundColor(r.getDirection());  // 返回背景颜色
+        color += h.getMaterial()->shade(r, h, tolight, lightColor);
+    }
+    return color;
+}
+
+bool Renderer::nextBounce(const Ray& r, const Hit& h, int depth, int bounces,
+                          Vector3f& throughput, Rng& rng, Ray& next) const {
+    if (depth >= bounces)
+        return false;
+    throughput = throughput * h.getMaterial()->getSpecularColor();
+    float weight = maxComponent(throughput);
+    if (!(weight >= kMinThroughput))
+        return false;  // 不再反射, 或贡献可以忽略
+    if (_args.roulette > 0 && depth + 1 >= _args.roulette && weight < 1.0f) {
+        // 以路径权重为概率继续, 存活的路径按概率放大, 期望不变
+        if (std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) >= weight)
+            return false;
+        throughput = throughput / weight;
+    }
+
+    Vector3f p = r.getOrigin() + r.getDirection() * h.getT();
+    Vector3f N = h.getNormal().normalized();                      // 交点处法向量
+    Vector3f L = -r.getDirection().normalized();                  // 交点到视点的方向
+    Vector3f R = (2 * Vector3f::dot(L, N) * N - L).normalized();  // 理想反射矢量
+    next = Ray(p + R * 0.001f, R);
+    return true;
 }
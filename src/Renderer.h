@@ -1,27 +1,116 @@
 #ifndef RENDERER_H
 #define RENDERER_H
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "SceneParser.h"
 #include "ArgParser.h"
 
+class AssetCache;
 class Hit;
+class Image;
 class Vector3f;
 class Ray;
+class Rng;
+class ThreadPool;
 
 class Renderer
 {
   public:
-    // Instantiates a renderer for the given scene.
-    Renderer(const ArgParser &args);
+    // 可选的辅助输出通道 (AOV)
+    enum Aov {
+        Normals,   // 主光线交点的法线, 映射到 [0,1]
+        Depth,     // 交点距离, 按 depth_min / depth_max 归一化
+        Albedo,    // 交点材质的漫反射颜色
+        ObjectId,  // 交点所属的顶层物体, 每个物体一种颜色
+        NumAovs
+    };
+
+    // Instantiates a renderer for the given scene, with the AOVs requested
+    // on the command line. With assets the meshes and the cube map of the
+    // scene are shared through that cache. The scene is loaded and rendered
+    // on pool, which may be busy with other renders at the same time;
+    // without one the renderer creates a pool of -threads threads.
+    Renderer(const ArgParser &args, AssetCache *assets = nullptr, ThreadPool *pool = nullptr);
+    ~Renderer();
+    // Renders aov along with the image and saves it to filename. AOVs that
+    // are not requested are neither allocated nor computed.
+    void addAov(Aov aov, const std::string &filename);
     void Render();
   private:
-    Vector3f traceRay(const Ray &ray, float tmin, int bounces, 
-                      Hit &hit) const;
+    static const int kTileSize = 32; // 并行渲染的图块边长
+    static constexpr float kMinThroughput = 1e-4f; // 路径贡献低于此值时终止
+    static const int kFilterScale = 3; // 滤波时每个输出像素每个方向的子采样数
+
+    // Where rendered pixels go: rows [y0, y0 + height) of the frame are
+    // stored in image, and in the AOV images that are not null.
+    struct Film {
+        Image *image;
+        Image *aovs[NumAovs];
+        int y0;
+    };
+    struct Progress;
+
+    // 以图块并行渲染 w x h 帧中的行 [y0, y1), 返回主光线数.
+    // pass >= 0 时只渲染每个像素的第 pass 个抖动采样 (渐进渲染的一遍)
+    long long renderRows(ThreadPool &pool, int y0, int y1, int w, int h, const Film &film,
+                         Progress &progress, int pass) const;
+    // Renders kFilterScale^2 subsamples per pixel in bands of rows and
+    // filters them into film as each band completes, so no buffer of the
+    // full subsample resolution exists.
+    long long renderFiltered(ThreadPool &pool, const Film &film, Progress &progress,
+                             int pass) const;
+    // Renders -progressive passes of one sample per pixel (or subsample)
+    // and accumulates them, resuming from and saving to -checkpoint. The
+    // current mean is written out every -write_every seconds or
+    // -write_passes passes; it is left in film.image at the end.
+    long long renderProgressive(ThreadPool &pool, const Film &film, Progress &progress) const;
+    // 将累加缓冲的均值填入 film.image, 并保存检查点
+    void writeProgress(const Film &film, const std::vector<Vector3f> &sums, int passes) const;
+    // 滤波时每带的子采样行数
+    int filterBandRows() const;
+
+    void renderPixel(int x, int y, int w, int h, const Film &film) const;
+    void renderQuad(int x, int y, int x1, int y1, int w, int h, const Film &film) const;
+    // Renders the pixels [x0, x1) x [y0, y1) from batches of samples.
+    // With -adaptive every pixel starts with min_samples and gets more
+    // while its error or the contrast to its neighbours is too high.
+    // With pass >= 0 only jittered sample number pass is traced.
+    // Returns the number of primary rays traced.
+    long long renderTile(int x0, int y0, int x1, int y1, int w, int h, const Film &film,
+                         int pass) const;
+    struct Sample;
+    // Traces every sample, storing its colour and first hit. With
+    // -wavefront the rays of all paths at one depth are intersected
+    // together, in packets.
+    void traceSamples(const std::vector<Sample> &samples, Vector3f *colors, Hit *hits) const;
+    void storePixel(int x, int y, const Vector3f &color, const Hit &hit, const Film &film) const;
+    // 主光线交点 hit 处 aov 的值
+    Vector3f aovValue(Aov aov, const Hit &hit) const;
+    // 像素坐标 (px, py) 处的主光线, 坐标可带抖动偏移
+    Ray primaryRay(float px, float py, int w, int h) const;
+    Vector3f traceRay(const Ray &ray, float tmin, int bounces,
+                      Hit &hit, Rng &rng) const;
+    // follows the path of ray from its first intersection hit for at most
+    // bounces reflections
+    Vector3f tracePath(const Ray &ray, float tmin, int bounces,
+                       const Hit &hit, Rng &rng) const;
+    // 交点 hit 处的直接光照
+    Vector3f shade(const Ray &ray, const Hit &hit) const;
+    // Continues a path at depth after it reached hit: scales throughput
+    // by the specular colour and returns false when the path ends, having
+    // made bounces reflections, being negligible or stopped by russian
+    // roulette.
+    bool nextBounce(const Ray &ray, const Hit &hit, int depth, int bounces,
+                    Vector3f &throughput, Rng &rng, Ray &next) const;
 
     ArgParser _args; // 程序执行参数
+    std::unique_ptr<ThreadPool> _ownPool; // 未传入线程池时自建的线程池
+    ThreadPool *_pool; // 加载网格与渲染所用的线程池
     SceneParser _scene; // 解析后的场景参数
+    std::string _aovFiles[NumAovs]; // 各 AOV 的输出文件, 为空表示不输出
 };
 
 #endif // RENDERER_H
@@ -1,6 +1,7 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <stdexcept>
 #define _USE_MATH_DEFINES
 #include <cmath>
 #ifndef M_PI
@@ -8,20 +9,22 @@
 #endif
 
 #include "SceneParser.h"
+#include "AssetCache.h"
 #include "Camera.h"
 #include "Light.h"
 #include "Material.h"
 
 #include "Object3D.h"
+#include "Stats.h"
 
 #define DegreesToRadians(x) ((M_PI * x) / 180.0f)
 
 static void _PostError(const std::string& msg) {
-    std::cout << msg;
-    exit(1);
+    throw std::runtime_error(msg);
 }
 
-SceneParser::SceneParser(const std::string& filename)
+SceneParser::SceneParser(const std::string& filename, const std::string& accel,
+                         const MeshOptions& meshOptions, AssetCache* assets)
     : _file(NULL),
       _camera(NULL),
       _background_color(0.5, 0.5, 0.5),  // 背景颜色
@@ -30,12 +33,16 @@ SceneParser::SceneParser(const std::string& filename)
       _num_materials(0),
       _current_material(NULL),
       _group(NULL),
-      _cubemap(NULL) {
+      _accel(accel),
+      _meshOptions(meshOptions),
+      _assets(assets) {
+    Stats::Timer timer(Stats::Parse);
+
     // parse the file
     assert(!filename.empty());
 
     if (filename.size() <= 4) {
-        _PostError("ERROR: Wrong file name extension\n");
+        _PostError("ERROR: Wrong file name extension");
     }
 
     size_t last_sep = filename.find_last_of("\\/");  // 查找路径分隔符
@@ -47,17 +54,23 @@ SceneParser::SceneParser(const std::string& filename)
 
     std::string ext = filename.substr(filename.size() - 4, 4);
     if (ext != ".txt") {  // 如果文件名后缀不是.txt
-        _PostError("ERROR: Wrong file name extension\n");
+        _PostError("ERROR: Wrong file name extension");
     }
 
     _file = fopen(filename.c_str(), "r");
 
     // FIXME extract base path from scene file path
     if (_file == NULL) {
-        _PostError(std::string("Cannot open scene file ") + filename + "\n");
+        _PostError(std::string("Cannot open scene file ") + filename);
     }
 
-    parseFile();    // 解析配置文件
+    try {
+        parseFile();  // 解析配置文件
+    } catch (...) {
+        fclose(_file);
+        clear();
+        throw;
+    }
     fclose(_file);  // 关闭文件
     _file = NULL;
 
@@ -70,6 +83,10 @@ SceneParser::SceneParser(const std::string& filename)
 }
 
 SceneParser::~SceneParser() {
+    clear();
+}
+
+void SceneParser::clear() {
     // FIXME Object3Ds leak. must keep track and delete.
     delete _group;
     delete _camera;
@@ -82,7 +99,6 @@ SceneParser::~SceneParser() {
     for (auto* object : _objects) {
         delete object;
     }
-    delete _cubemap;
 }
 
 // ====================================================================
@@ -107,9 +123,7 @@ void SceneParser::parseFile() {
         else if (!strcmp(token, "Group"))
             _group = parseGroup();  // 初始化物体组配置
         else {
-            _PostError(std::string("Unknown token in parseFile: '") + token +
-                       "'\n");
-            exit(1);
+            _PostError(std::string("Unknown token in parseFile: '") + token + "'");
         }
     }
 }
@@ -156,16 +170,17 @@ void SceneParser::parseBackground() {
         } else if (!strcmp(token, "cubeMap")) {
             _cubemap = parseCubeMap();  // 背景盒子贴图
         } else {
-            printf("Unknown token in parseBackground: '%s'\n", token);
-            assert(0);
+            _PostError(std::string("Unknown token in parseBackground: '") + token + "'");
         }
     }
 }
 
-CubeMap* SceneParser::parseCubeMap() {
+std::shared_ptr<const CubeMap> SceneParser::parseCubeMap() {
     char token[MAX_PARSER_TOKEN_LENGTH];
     getToken(token);
-    return new CubeMap(_basepath + token);
+    if (_assets)
+        return _assets->getCubeMap(_basepath + token);
+    return std::make_shared<CubeMap>(_basepath + token);
 }
 
 // ====================================================================
@@ -186,8 +201,7 @@ void SceneParser::parseLights() {
         } else if (strcmp(token, "PointLight") == 0) {
             lights.push_back(parsePointLight());  // 添加点光源
         } else {
-            printf("Unknown token in parseLight: '%s'\n", token);
-            exit(0);
+            _PostError(std::string("Unknown token in parseLight: '") + token + "'");
         }
         count++;
     }
@@ -248,8 +262,7 @@ void SceneParser::parseMaterials() {
         if (!strcmp(token, "Material") || !strcmp(token, "PhongMaterial")) {
             _materials.push_back(parseMaterial());  // 添加材质
         } else {
-            printf("Unknown token in parseMaterial: '%s'\n", token);
-            exit(0);
+            _PostError(std::string("Unknown token in parseMaterial: '") + token + "'");
         }
         count++;
     }
@@ -304,8 +317,7 @@ Object3D* SceneParser::parseObject(char token[MAX_PARSER_TOKEN_LENGTH]) {
     else if (!strcmp(token, "Transform"))
         answer = (Object3D*)parseTransform();  // 解析变换
     else {
-        printf("Unknown token in parseObject: '%s'\n", token);
-        exit(0);
+        _PostError(std::string("Unknown token in parseObject: '") + token + "'");
     }
     return answer;
 }
@@ -353,6 +365,8 @@ Group* SceneParser::parseGroup() {
     getToken(token);
     assert(!strcmp(token, "}"));
 
+    answer->build();  // 构建顶层加速结构
+
     // return the group
     return answer;
 }
@@ -423,13 +437,27 @@ Mesh* SceneParser::parseTriangleMesh() {
     getToken(token);
     assert(!strcmp(token, "obj_file"));
     getToken(filename);
+    std::string accelName = "bvh";  // 默认使用BVH加速结构
     getToken(token);
+    if (!strcmp(token, "accel")) {  // 可选: 指定加速结构
+        getToken(token);
+        accelName = token;
+        getToken(token);
+    }
     assert(!strcmp(token, "}"));
-    const char* ext = &filename[strlen(filename) - 4];  // 获取物体文件后缀
-    assert(!strcmp(ext, ".obj"));
-    Mesh* answer = new Mesh(_basepath + filename, _current_material);
-
-    return answer;
+    assert(!strcmp(&filename[strlen(filename) - 4], ".obj"));  // 物体文件后缀须为 .obj
+    if (!_accel.empty())
+        accelName = _accel;  // 命令行优先
+    AccelType accel;
+    if (!Mesh::parseAccelType(accelName, accel)) {
+        _PostError(std::string("Unknown acceleration structure '") + accelName + "'");
+    }
+    // 网格文件无法读取时 Mesh 抛出 std::runtime_error, 交给调用者处理
+    if (_assets) {
+        return new Mesh(_assets->getMesh(_basepath + filename, accel, _meshOptions),
+                        _current_material);
+    }
+    return new Mesh(_basepath + filename, _current_material, accel, _meshOptions);
 }
 
 Transform* SceneParser::parseTransform() {
@@ -518,8 +546,7 @@ Vector3f SceneParser::readVector3f() {
     float x, y, z;
     int count = fscanf(_file, "%f %f %f", &x, &y, &z);
     if (count != 3) {
-        printf("Error trying to read 3 floats to make a Vector3f\n");
-        assert(0);
+        _PostError("Error trying to read 3 floats to make a Vector3f");
     }
     return Vector3f(x, y, z);
 }
@@ -528,8 +555,7 @@ Vector2f SceneParser::readVec2f() {
     float u, v;
     int count = fscanf(_file, "%f %f", &u, &v);
     if (count != 2) {
-        printf("Error trying to read 2 floats to make a Vec2f\n");
-        assert(0);
+        _PostError("Error trying to read 2 floats to make a Vec2f");
     }
     return Vector2f(u, v);
 }
@@ -538,8 +564,7 @@ float SceneParser::readFloat() {
     float answer;
     int count = fscanf(_file, "%f", &answer);
     if (count != 1) {
-        printf("Error trying to read 1 float\n");
-        assert(0);
+        _PostError("Error trying to read 1 float");
     }
     return answer;
 }
@@ -548,8 +573,7 @@ int SceneParser::readInt() {
     int answer;
     int count = fscanf(_file, "%d", &answer);
     if (count != 1) {
-        printf("Error trying to read 1 int\n");
-        assert(0);
+        _PostError("Error trying to read 1 int");
     }
     return answer;
 }
@@ -2,6 +2,7 @@
 #define SCENE_PARSER_H
 
 #include <cassert>
+#include <memory>
 #include <vector>
 #include <vecmath.h>
 
@@ -15,9 +16,18 @@
 
 #define MAX_PARSER_TOKEN_LENGTH 100
 
+class AssetCache;
+
 class SceneParser {
    public:
-    SceneParser(const std::string& filename);
+    // accel overrides the acceleration structure of every TriangleMesh
+    // ("octree" / "bvh"); when empty each mesh uses its own setting.
+    // With assets the meshes and the cube map come from that cache, shared
+    // with the other scenes using it.
+    // Throws std::runtime_error if the scene file cannot be read or parsed,
+    // or one of its meshes cannot be loaded.
+    SceneParser(const std::string& filename, const std::string& accel = "",
+                const MeshOptions& meshOptions = MeshOptions(), AssetCache* assets = nullptr);
     ~SceneParser();
 
     Camera* getCamera() const { return _camera; }
@@ -51,6 +61,8 @@ class SceneParser {
     std::vector<Light*> lights;  // 光源数组
 
    private:
+    // 释放已解析出的对象, 析构及解析失败时调用
+    void clear();
     void parseFile();
     void parsePerspectiveCamera();
     void parseBackground();
@@ -67,7 +79,7 @@ class SceneParser {
     Triangle* parseTriangle();
     Mesh* parseTriangleMesh();
     Transform* parseTransform();
-    CubeMap* parseCubeMap();
+    std::shared_ptr<const CubeMap> parseCubeMap();
 
     int getToken(char token[MAX_PARSER_TOKEN_LENGTH]);
     Vector3f readVector3f();
@@ -86,7 +98,10 @@ class SceneParser {
     std::vector<Object3D*> _objects;    // 物体数组
     Material* _current_material;        // 当前物体对应的材质
     Group* _group;                      // 物体组 vector<Object3D*> m_members
-    CubeMap* _cubemap;                  // 背景盒子贴图
+    std::shared_ptr<const CubeMap> _cubemap;  // 背景盒子贴图
+    std::string _accel;                 // 命令行指定的网格加速结构
+    MeshOptions _meshOptions;           // 网格的加载方式
+    AssetCache* _assets;                // 共享的网格与贴图, 可为空
 };
 
 #endif  // SCENE_PARSER_H
@@ -0,0 +1,159 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+// Minimal 4-wide float vector used by the packet and leaf kernels.
+// Backed by SSE when available, plain arrays otherwise. Every operation
+// is a single IEEE operation per lane, so the results match the scalar
+// code bit for bit.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define A2_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#include <cmath>
+#endif
+
+struct Float4 {
+#ifdef A2_SIMD_SSE
+    __m128 v;
+
+    Float4() {}
+    Float4(__m128 x) : v(x) {}
+    explicit Float4(float f) : v(_mm_set1_ps(f)) {}
+
+    static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+
+    // comparisons return a lane mask
+    friend Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+    friend Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+    friend Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+    friend Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+
+    // lane i of the mask as bit i
+    int mask() const { return _mm_movemask_ps(v); }
+
+    // mask ? a : b per lane
+    static Float4 select(Float4 mask, Float4 a, Float4 b) {
+        return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+    }
+    static Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+    static Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+    static Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+#else
+    float v[4];
+
+    Float4() {}
+    explicit Float4(float f) { v[0] = v[1] = v[2] = v[3] = f; }
+
+    static Float4 load(const float* p) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = p[i];
+        return r;
+    }
+    void store(float* p) const {
+        for (int i = 0; i < 4; i++)
+            p[i] = v[i];
+    }
+
+#define A2_FLOAT4_BINARY(op)                         \
+    friend Float4 operator op(Float4 a, Float4 b) {  \
+        Float4 r;                                    \
+        for (int i = 0; i < 4; i++)                  \
+            r.v[i] = a.v[i] op b.v[i];               \
+        return r;                                    \
+    }
+    A2_FLOAT4_BINARY(+)
+    A2_FLOAT4_BINARY(-)
+    A2_FLOAT4_BINARY(*)
+    A2_FLOAT4_BINARY(/)
+#undef A2_FLOAT4_BINARY
+
+    friend Float4 operator-(Float4 a) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = -a.v[i];
+        return r;
+    }
+
+    // comparisons return a lane mask: 1 for true, 0 for false
+#define A2_FLOAT4_COMPARE(op)                        \
+    friend Float4 operator op(Float4 a, Float4 b) {  \
+        Float4 r;                                    \
+        for (int i = 0; i < 4; i++)                  \
+            r.v[i] = a.v[i] op b.v[i] ? 1.0f : 0.0f; \
+        return r;                                    \
+    }
+    A2_FLOAT4_COMPARE(<)
+    A2_FLOAT4_COMPARE(>)
+#undef A2_FLOAT4_COMPARE
+
+    friend Float4 operator&(Float4 a, Float4 b) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = (a.v[i] != 0 && b.v[i] != 0) ? 1.0f : 0.0f;
+        return r;
+    }
+    friend Float4 operator|(Float4 a, Float4 b) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = (a.v[i] != 0 || b.v[i] != 0) ? 1.0f : 0.0f;
+        return r;
+    }
+
+    int mask() const {
+        int m = 0;
+        for (int i = 0; i < 4; i++)
+            if (v[i] != 0)
+                m |= 1 << i;
+        return m;
+    }
+
+    static Float4 select(Float4 mask, Float4 a, Float4 b) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i];
+        return r;
+    }
+    static Float4 sqrt(Float4 a) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = std::sqrt(a.v[i]);
+        return r;
+    }
+    static Float4 abs(Float4 a) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = std::fabs(a.v[i]);
+        return r;
+    }
+    static Float4 max(Float4 a, Float4 b) {
+        Float4 r;
+        for (int i = 0; i < 4; i++)
+            r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i];
+        return r;
+    }
+#endif
+};
+
+// Lane mask as a Float4, for combining with comparison results
+inline Float4 laneMask(int bits) {
+#ifdef A2_SIMD_SSE
+    return _mm_castsi128_ps(_mm_set_epi32(-((bits >> 3) & 1), -((bits >> 2) & 1),
+                                          -((bits >> 1) & 1), -(bits & 1)));
+#else
+    Float4 r;
+    for (int i = 0; i < 4; i++)
+        r.v[i] = (bits >> i) & 1 ? 1.0f : 0.0f;
+    return r;
+#endif
+}
+
+#endif  // SIMD_H
@@ -0,0 +1,111 @@
+#include "Stats.h"
+
+#include "MemoryUsage.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+std::atomic<uint64_t> g_totals[Stats::NumCounters];  // 各线程已并入的计数
+double g_seconds[Stats::NumPhases];                  // 主线程上各阶段累计耗时
+std::mutex g_otherMutex;                             // 保护 g_otherSeconds
+double g_otherSeconds[Stats::NumPhases];             // 其他线程上各阶段耗时之和
+thread_local int t_phase = -1;                       // 本线程正在计时的阶段, -1 表示没有
+thread_local Clock::time_point t_phaseStart;         // 该阶段本次开始计时的时刻
+const Clock::time_point g_processStart = Clock::now();
+const std::thread::id g_mainThread = std::this_thread::get_id();  // 静态初始化所在的线程
+
+const char *const kPhaseNames[Stats::NumPhases] = {"parse",  "mesh load", "accel build",
+                                                   "render", "filter",    "write"};
+
+// 把本线程当前阶段到 now 为止的耗时记入该阶段
+void stopPhase(Clock::time_point now) {
+    if (t_phase >= 0) {
+        double seconds = std::chrono::duration<double>(now - t_phaseStart).count();
+        if (std::this_thread::get_id() == g_mainThread) {
+            g_seconds[t_phase] += seconds;
+        } else {
+            std::lock_guard<std::mutex> lock(g_otherMutex);
+            g_otherSeconds[t_phase] += seconds;
+        }
+    }
+    t_phaseStart = now;
+}
+
+}  // namespace
+
+thread_local uint64_t Stats::t_counts[Stats::NumCounters];
+
+void Stats::flush() {
+    for (int c = 0; c < NumCounters; c++) {
+        if (t_counts[c]) {
+            g_totals[c] += t_counts[c];
+            t_counts[c] = 0;
+        }
+    }
+}
+
+uint64_t Stats::total(Counter c) {
+    return g_totals[c];
+}
+
+Stats::Timer::Timer(Phase phase) : _parent(t_phase) {
+    stopPhase(Clock::now());
+    t_phase = phase;
+}
+
+Stats::Timer::~Timer() {
+    stopPhase(Clock::now());
+    t_phase = _parent;
+}
+
+double Stats::seconds(Phase phase) {
+    return g_seconds[phase];
+}
+
+void Stats::report(std::ostream &out) {
+    flush();
+    std::chrono::duration<double> elapsed = Clock::now() - g_processStart;
+    out << "Stats:\n";
+    out << "- time: " << elapsed.count() << " s total";
+    for (int p = 0; p < NumPhases; p++)
+        out << ", " << kPhaseNames[p] << " " << g_seconds[p] << " s";
+    out << "\n";
+    {
+        std::lock_guard<std::mutex> lock(g_otherMutex);
+        double other = 0;
+        for (int p = 0; p < NumPhases; p++)
+            other += g_otherSeconds[p];
+        if (other > 0) {
+            // 与上面主线程的时间重叠, 不计入其中
+            out << "- other threads (summed, not in the times above):";
+            for (int p = 0; p < NumPhases; p++)
+                out << (p ? ", " : " ") << kPhaseNames[p] << " " << g_otherSeconds[p] << " s";
+            out << "\n";
+        }
+    }
+
+    const double renderSeconds = g_seconds[Render] > 0 ? g_seconds[Render] : 1;
+    const char *const rayNames[] = {"primary", "shadow", "reflection"};
+    const Counter rayCounters[] = {PrimaryRays, ShadowRays, ReflectionRays};
+    uint64_t rays = 0;
+    out << "- rays:";
+    for (int i = 0; i < 3; i++) {
+        uint64_t n = total(rayCounters[i]);
+        rays += n;
+        out << (i ? ", " : " ") << rayNames[i] << " " << n << " (" << n / renderSeconds / 1e6
+            << " M/s)";
+    }
+    out << "\n";
+
+    const double perRay = rays ? 1.0 / rays : 0;
+    out << "- per ray: " << total(BoxTests) * perRay << " box tests, "
+        << total(TriangleTests) * perRay << " triangle tests, " << total(OctreeNodes) * perRay
+        << " octree nodes\n";
+    out << "- peak RSS: " << peakResidentBytes() / (1024 * 1024) << " MiB" << std::endl;
+}
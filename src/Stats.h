@@ -0,0 +1,74 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <ostream>
+
+// Counters and phase timers reported by -stats.
+//
+// The counters are cheap enough to stay on in every build: each thread
+// adds to its own thread_local block with plain increments, and flush()
+// moves the block of the calling thread into the shared totals. The
+// renderer flushes after every tile, so hot loops never write shared
+// memory.
+//
+// Every thread times its own phases. A Timer pauses the phase that is
+// running on its thread when it starts, so nested phases (a mesh load
+// during parsing) are not counted twice. The phase times are those of the
+// main thread; phases timed on other threads, such as the jobs of a -jobs
+// batch running on the pool, overlap them and are summed over the threads
+// on a separate line of the report.
+class Stats
+{
+  public:
+    enum Counter {
+        PrimaryRays,
+        ShadowRays,
+        ReflectionRays,
+        BoxTests,       // 光线与包围盒的求交测试, 光线包中每条光线各计一次
+        TriangleTests,  // 光线与三角形的求交测试, 按 SIMD 块的通道计
+        OctreeNodes,    // 八叉树遍历进入的节点
+        NumCounters
+    };
+
+    enum Phase {
+        Parse,       // 场景文件解析, 不含网格读取与加速结构构建
+        MeshLoad,    // 读取 OBJ 文件或网格缓存
+        AccelBuild,  // 构建网格的 BVH / 八叉树
+        Render,      // 光线追踪
+        Filter,      // 重建滤波
+        Write,       // 写出图片与检查点
+        NumPhases
+    };
+
+    static void count(Counter c, uint64_t n = 1) { t_counts[c] += n; }
+
+    // 将当前线程的计数并入总数
+    static void flush();
+    static uint64_t total(Counter c);
+
+    // Attributes the time between construction and destruction to phase
+    class Timer
+    {
+      public:
+        explicit Timer(Phase phase);
+        ~Timer();
+
+        Timer(const Timer &) = delete;
+        Timer &operator=(const Timer &) = delete;
+
+      private:
+        int _parent;  // 被暂停的阶段, -1 表示没有
+    };
+    // 主线程上该阶段的累计耗时
+    static double seconds(Phase phase);
+
+    // Prints the phase times, those summed over the other threads, the rays of each type and their rate over
+    // the render phase, the tests per ray and the peak memory.
+    static void report(std::ostream &out);
+
+  private:
+    static thread_local uint64_t t_counts[NumCounters];
+};
+
+#endif  // STATS_H
@@ -0,0 +1,175 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+thread_local const ThreadPool* t_pool = nullptr;  // 当前线程所属的线程池
+thread_local int t_index = 0;                     // 当前线程在线程池中的编号
+thread_local const TaskGroup* t_group = nullptr;  // 当前线程正在执行的任务所属的组
+}  // namespace
+
+ThreadPool::ThreadPool(int numThreads)
+    : _numThreads(numThreads),
+      _nextQueue(0),
+      _queued(0),
+      _waiters(0),
+      _submitted(0),
+      _stop(false) {
+    if (_numThreads <= 0)
+        _numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    _queues = std::vector<Queue>(_numThreads);
+    for (int i = 1; i < _numThreads; i++)
+        _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _sleepCv.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+void ThreadPool::submit(TaskGroup& group, std::function<void()> task) {
+    group._pending++;
+    group._parent = t_group;
+    // 工作线程提交到自己的队列, 外部线程轮流分发
+    int q = (t_pool == this) ? t_index : (int)(_nextQueue++ % _numThreads);
+    {
+        std::lock_guard<std::mutex> lock(_queues[q].mutex);
+        _queues[q].tasks.push_back({std::move(task), &group});
+    }
+    _queued++;
+    bool waiters;
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _submitted++;
+        waiters = _waiters > 0;
+    }
+    _sleepCv.notify_one();
+    if (waiters)
+        _waitCv.notify_all();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    int index = (t_pool == this) ? t_index : 0;
+    while (group._pending > 0) {
+        unsigned submitted;
+        {
+            std::lock_guard<std::mutex> lock(_sleepMutex);
+            submitted = _submitted;
+        }
+        if (tryRunTask(index, &group))
+            continue;
+        // 没有可帮忙的任务: 休眠到组完成或有新任务提交
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _waiters++;
+        _waitCv.wait(lock, [&]() { return group._pending == 0 || _submitted != submitted; });
+        _waiters--;
+    }
+    if (group._error)
+        std::rethrow_exception(group._error);
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int)>& fn) {
+    TaskGroup group;
+    for (int i = 0; i < count; i++)
+        submit(group, [&fn, i]() { fn(i); });
+    wait(group);
+}
+
+void ThreadPool::workerLoop(int index) {
+    t_pool = this;
+    t_index = index;
+    while (true) {
+        if (tryRunTask(index, nullptr))
+            continue;
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _sleepCv.wait(lock, [this]() { return _stop || _queued > 0; });
+        if (_stop)
+            return;
+    }
+}
+
+bool ThreadPool::inScope(const TaskGroup* group, const TaskGroup* scope) {
+    // 祖先组的任务都在等待子组, 因此沿 _parent 访问的组都还存活
+    for (; group; group = group->_parent)
+        if (group == scope)
+            return true;
+    return false;
+}
+
+bool ThreadPool::tryRunTask(int index, const TaskGroup* scope) {
+    Task task;
+    bool found = false;
+    {
+        // 先从自己队列的尾部取任务
+        std::deque<Task>& tasks = _queues[index].tasks;
+        std::lock_guard<std::mutex> lock(_queues[index].mutex);
+        for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+            if (!scope || inScope(it->group, scope)) {
+                task = std::move(*it);
+                tasks.erase(std::next(it).base());
+                found = true;
+                break;
+            }
+        }
+    }
+    // 再从其他队列的头部窃取任务
+    for (int i = 1; !found && i < _numThreads; i++) {
+        Queue& victim = _queues[(index + i) % _numThreads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        for (auto it = victim.tasks.begin(); it != victim.tasks.end(); ++it) {
+            if (!scope || inScope(it->group, scope)) {
+                task = std::move(*it);
+                victim.tasks.erase(it);
+                found = true;
+                break;
+            }
+        }
+    }
+    if (!found)
+        return false;
+    _queued--;
+    runTask(task);
+    return true;
+}
+
+void ThreadPool::runTask(Task& task) {
+    // 让在外部线程中执行的任务也能把子任务提交到本线程池
+    const ThreadPool* prevPool = t_pool;
+    int prevIndex = t_index;
+    if (t_pool != this) {
+        t_pool = this;
+        t_index = 0;
+    }
+    const TaskGroup* prevGroup = t_group;
+    t_group = task.group;
+    try {
+        task.fn();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(task.group->_errorMutex);
+        if (!task.group->_error)
+            task.group->_error = std::current_exception();
+    }
+    t_pool = prevPool;
+    t_index = prevIndex;
+    t_group = prevGroup;
+    finishTask(*task.group);
+}
+
+void ThreadPool::finishTask(TaskGroup& group) {
+    if (--group._pending > 0)
+        return;
+    // 此后 group 可能已被等待者销毁, 不再访问它
+    bool waiters;
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        waiters = _waiters > 0;
+    }
+    if (waiters)
+        _waitCv.notify_all();
+}
@@ -0,0 +1,93 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 一组可以一起等待的任务
+class TaskGroup {
+   public:
+    TaskGroup() : _pending(0), _parent(nullptr) {}
+
+   private:
+    friend class ThreadPool;
+    std::atomic<int> _pending;  // 尚未完成的任务数
+    const TaskGroup* _parent;   // 提交本组任务的那个任务所属的组, 在任务外提交时为空
+    std::mutex _errorMutex;
+    std::exception_ptr _error;  // 第一个抛出的异常, 由 wait() 重新抛出
+};
+
+// Work-stealing thread pool.
+// Every worker owns a deque: it pops its own tasks from the back and
+// steals from the front of the other deques when it runs dry.
+// Threads that wait on a TaskGroup keep executing tasks, so tasks may
+// spawn and wait on sub-tasks without deadlocking the pool; when there is
+// nothing to run they sleep until the group is done or work arrives.
+// A waiting thread only helps with tasks of the awaited group and of the
+// groups submitted from inside them, so an unrelated long task (e.g. a
+// whole job of a batch) is never started on top of a half-finished one.
+// A task that throws still counts as done: the first exception of a group
+// is rethrown by wait() once all of its tasks have finished.
+class ThreadPool {
+   public:
+    // numThreads <= 0 uses every hardware thread.
+    // With numThreads == 1 no worker is spawned and all tasks run on the
+    // thread that calls wait().
+    explicit ThreadPool(int numThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Total number of threads working on tasks, including the caller of wait()
+    int getNumThreads() const { return _numThreads; }
+
+    void submit(TaskGroup& group, std::function<void()> task);
+
+    // Blocks until every task of the group is done, helping meanwhile.
+    // Rethrows the first exception thrown by a task of the group.
+    void wait(TaskGroup& group);
+
+    // Runs fn(i) for i in [0, count) and waits for all of them.
+    void parallelFor(int count, const std::function<void(int)>& fn);
+
+   private:
+    struct Task {
+        std::function<void()> fn;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(int index);
+    // scope 非空时只执行属于 scope 或其子孙组的任务
+    bool tryRunTask(int index, const TaskGroup* scope);
+    static bool inScope(const TaskGroup* group, const TaskGroup* scope);
+    void runTask(Task& task);
+    // 任务结束后减少组的计数, 组完成时唤醒等待者
+    void finishTask(TaskGroup& group);
+
+    int _numThreads;
+    std::vector<std::thread> _workers;
+    // 每个线程一个任务队列; 工作线程用 1 号起, 调用 wait() 的外部线程共用 0 号
+    std::vector<Queue> _queues;
+    std::atomic<unsigned> _nextQueue;   // 外部提交任务时轮流选择的队列
+    std::atomic<int> _queued;           // 队列中等待执行的任务数
+    std::mutex _sleepMutex;             // 保护以下成员
+    std::condition_variable _sleepCv;   // 空闲的工作线程在此休眠
+    std::condition_variable _waitCv;    // 无任务可帮的 wait() 在此休眠
+    int _waiters;                       // 在 _waitCv 上休眠的线程数
+    unsigned _submitted;                // 已提交的任务数, wait() 据此发现新任务
+    bool _stop;
+};
+
+#endif  // THREAD_POOL_H
@@ -0,0 +1,32 @@
+#ifndef TRAVERSAL_H
+#define TRAVERSAL_H
+
+#include "Ray.h"
+
+#include <cstdint>
+
+class Mesh;
+
+// Per-ray state of one mesh traversal.
+// The caller owns it (usually on its stack), so Mesh and its
+// acceleration structure stay const and can be shared between threads.
+struct TraversalContext
+{
+    TraversalContext(const Mesh &m, const Ray &r, float tmin, Hit &h) :
+        mesh(m),
+        ray(r),
+        tmin(tmin),
+        hit(h),
+        mirror(0),
+        anyHit(false)
+    {}
+
+    const Mesh &mesh;  // 被遍历的网格
+    const Ray &ray;    // 当前光线
+    float tmin;        // 最小相交距离
+    Hit &hit;          // 当前最近交点
+    uint8_t mirror;    // 八叉树遍历时光线方向的镜像掩码
+    bool anyHit;       // 遮挡查询: 找到任意交点即可停止 (hit.t 为最大距离)
+};
+
+#endif // TRAVERSAL_H
@@ -0,0 +1,167 @@
+#ifndef TRIANGLE_BLOCK_H
+#define TRIANGLE_BLOCK_H
+
+#include "Ray.h"
+#include "RayPacket.h"
+#include "Simd.h"
+#include "Vector3f.h"
+
+#include <cstdint>
+
+// Möller-Trumbore for one triangle given by v0 and its edges against the
+// packet lanes in mask. The steps are those of Triangle::intersectT, so
+// every lane gets the scalar result bit for bit.
+// Returns the lanes with t in (tmin, tmax[lane]) and stores their t.
+inline int
+intersectTrianglePacket(const Vector3f &v0, const Vector3f &e1, const Vector3f &e2,
+                        const RayPacket &rays, int mask, float tmin,
+                        const float *tmax, float *tOut)
+{
+    Float4 e1x(e1[0]), e1y(e1[1]), e1z(e1[2]);
+    Float4 e2x(e2[0]), e2y(e2[1]), e2z(e2[2]);
+
+    Float4 dx = Float4::load(rays.dx), dy = Float4::load(rays.dy), dz = Float4::load(rays.dz);
+    Float4 sx = Float4::load(rays.ox) - Float4(v0[0]);
+    Float4 sy = Float4::load(rays.oy) - Float4(v0[1]);
+    Float4 sz = Float4::load(rays.oz) - Float4(v0[2]);
+
+    // S1 = d x E2, S2 = S x E1
+    Float4 s1x = dy * e2z - dz * e2y;
+    Float4 s1y = dz * e2x - dx * e2z;
+    Float4 s1z = dx * e2y - dy * e2x;
+    Float4 s2x = sy * e1z - sz * e1y;
+    Float4 s2y = sz * e1x - sx * e1z;
+    Float4 s2z = sx * e1y - sy * e1x;
+
+    Float4 s1e1 = s1x * e1x + s1y * e1y + s1z * e1z;
+    Float4 t = (s2x * e2x + s2y * e2y + s2z * e2z) / s1e1;
+    Float4 b1 = (s1x * sx + s1y * sy + s1z * sz) / s1e1;
+    Float4 b2 = (s2x * dx + s2y * dy + s2z * dz) / s1e1;
+
+    Float4 zero(0.0f);
+    Float4 inside = (t > Float4(tmin)) & (t < Float4::load(tmax)) & (b1 > zero) & (b2 > zero) &
+                    ((Float4(1.0f) - b1 - b2) > zero);
+    t.store(tOut);
+    return mask & inside.mask();
+}
+
+// Four triangles of a mesh leaf in structure-of-arrays layout, with the
+// edges precomputed, so one ray is tested against all of them by a
+// single SIMD Möller-Trumbore kernel.
+// Unused lanes have prim < 0 and never report a hit.
+struct TriangleBlock
+{
+    static const int kSize = 4;
+
+    float v0[3][kSize];     // 第一个顶点
+    float e1[3][kSize];     // 边 v1 - v0
+    float e2[3][kSize];     // 边 v2 - v0
+    int32_t prim[kSize];    // 三角形在网格中的下标, -1 表示空通道
+
+    // blocks needed for count triangles
+    static int numBlocks(int count)
+    {
+        return (count + kSize - 1) / kSize;
+    }
+
+    TriangleBlock()
+    {
+        for (int lane = 0; lane < kSize; lane++) {
+            clear(lane);
+        }
+    }
+
+    void set(int lane, int index, const Vector3f &a, const Vector3f &b, const Vector3f &c)
+    {
+        const Vector3f ea = b - a;
+        const Vector3f eb = c - a;
+        for (int dim = 0; dim < 3; dim++) {
+            v0[dim][lane] = a[dim];
+            e1[dim][lane] = ea[dim];
+            e2[dim][lane] = eb[dim];
+        }
+        prim[lane] = index;
+    }
+
+    void clear(int lane)
+    {
+        for (int dim = 0; dim < 3; dim++) {
+            v0[dim][lane] = 0;
+            e1[dim][lane] = 0;
+            e2[dim][lane] = 0;
+        }
+        prim[lane] = -1;
+    }
+
+    Vector3f getV0(int lane) const
+    {
+        return Vector3f(v0[0][lane], v0[1][lane], v0[2][lane]);
+    }
+
+    Vector3f getE1(int lane) const
+    {
+        return Vector3f(e1[0][lane], e1[1][lane], e1[2][lane]);
+    }
+
+    Vector3f getE2(int lane) const
+    {
+        return Vector3f(e2[0][lane], e2[1][lane], e2[2][lane]);
+    }
+
+    // Lanes whose triangle the ray hits with t in (tmin, tmax); t[lane]
+    // receives the distances. Same steps as Triangle::intersectT.
+    int intersect(const Ray &r, float tmin, float tmax, float *t) const;
+
+    // Closest triangle with t in (tmin, tmax). On ties the lower lane
+    // wins, as when the triangles are tested one after another.
+    // Returns the lane, or -1.
+    int closest(const Ray &r, float tmin, float tmax, float &t) const
+    {
+        float ts[kSize];
+        int m = intersect(r, tmin, tmax, ts);
+        int best = -1;
+        for (int lane = 0; m; lane++, m >>= 1) {
+            if ((m & 1) && ts[lane] < tmax) {
+                tmax = ts[lane];
+                best = lane;
+            }
+        }
+        t = tmax;
+        return best;
+    }
+};
+
+inline int
+TriangleBlock::intersect(const Ray &r, float tmin, float tmax, float *t) const
+{
+    const Vector3f o = r.getOrigin();
+    const Vector3f d = r.getDirection();
+    Float4 dx(d[0]), dy(d[1]), dz(d[2]);
+    Float4 e1x = Float4::load(e1[0]), e1y = Float4::load(e1[1]), e1z = Float4::load(e1[2]);
+    Float4 e2x = Float4::load(e2[0]), e2y = Float4::load(e2[1]), e2z = Float4::load(e2[2]);
+    Float4 sx = Float4(o[0]) - Float4::load(v0[0]);
+    Float4 sy = Float4(o[1]) - Float4::load(v0[1]);
+    Float4 sz = Float4(o[2]) - Float4::load(v0[2]);
+
+    // S1 = d x E2, S2 = S x E1
+    Float4 s1x = dy * e2z - dz * e2y;
+    Float4 s1y = dz * e2x - dx * e2z;
+    Float4 s1z = dx * e2y - dy * e2x;
+    Float4 s2x = sy * e1z - sz * e1y;
+    Float4 s2y = sz * e1x - sx * e1z;
+    Float4 s2z = sx * e1y - sy * e1x;
+
+    Float4 s1e1 = s1x * e1x + s1y * e1y + s1z * e1z;
+    Float4 tt = (s2x * e2x + s2y * e2y + s2z * e2z) / s1e1;
+    Float4 b1 = (s1x * sx + s1y * sy + s1z * sz) / s1e1;
+    Float4 b2 = (s2x * dx + s2y * dy + s2z * dz) / s1e1;
+
+    // empty lanes have zero edges, so s1e1 = 0 and t is NaN: never a hit
+    Float4 zero(0.0f);
+    Float4 inside = (tt > Float4(tmin)) & (tt < Float4(tmax)) & (b1 > zero) & (b2 > zero) &
+                    ((Float4(1.0f) - b1 - b2) > zero);
+    tt.store(t);
+    return inside.mask();
+}
+
+#endif // TRIANGLE_BLOCK_H
@@ -1,7 +1,9 @@
 #include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 #include "ArgParser.h"
+#include "Batch.h"
 #include "Renderer.h"
 
 int main(int argc, const char *argv[])
@@ -16,14 +18,37 @@ int main(int argc, const char *argv[])
                   << "\t-output <image.png>\n"
                   << "\t[-depth <depth_min> <depth_max> <depth_image.png>\n]"
                   << "\t[-normals <normals_image.png>]\n"
+                  << "\t[-albedo <albedo_image.png>] [-ids <object_id_image.png>]\n"
                   << "\t[-bounces <max_bounces>\n]"
+                  << "\t[-roulette <first_bounce>]\n"
                   << "\t[-shadows\n]"
+                  << "\t[-accel <octree|bvh>]\n"
+                  << "\t[-cache_dir <dir>] [-no_cache]\n"
+                  << "\t[-jitter] [-filter [box|tent|gaussian|mitchell]]\n"
+                  << "\t[-samples <min> <max>] [-adaptive <max_error>]\n"
+                  << "\t[-progressive <passes>] [-checkpoint <file>]\n"
+                  << "\t[-write_every <seconds>] [-write_passes <passes>]\n"
+                  << "\t[-threads <num_threads>]\n"
+                  << "\t[-packets]\n"
+                  << "\t[-wavefront]\n"
+                  << "\t[-stats]\n"
+                  << "\t[-jobs <job_file>]  (one line of the other args per job)\n"
                   << "\n";
         return 1;
     }
 
     ArgParser argsParser(argc, argv);
-    Renderer renderer(argsParser);
-    renderer.Render();
+    if (!argsParser.jobs_file.empty())
+        return runBatch(argc, argv, argsParser);
+    try
+    {
+        Renderer renderer(argsParser);
+        renderer.Render();
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
     return 0;
 }
@@ -0,0 +1,254 @@
+// Image regression test against the reference renders in sample_out/.
+//
+// Renders every scene with the settings of sample_out/generate_images.sh,
+// then compares the image, the normals and the depth map with the
+// references. A comparison fails if its RMSE, PSNR or maximum channel
+// error is outside the limits; the absolute difference of every image is
+// written next to the render as <name>_diff.png.
+//
+// The mesh scenes can only be checked loosely against the references (see
+// Case::flatShadedRmse). Their image and normals must also match the
+// flat-shaded renders checked in under test/flat_shaded/, and renders with
+// the octree, ray packets and the wavefront loop must match the default
+// one, both under the normal limits.
+//
+// ctest runs one case per test, see CMakeLists.txt.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+namespace {
+
+struct Limits {
+    double maxRmse;
+    double minPsnr;
+    double maxError;
+};
+
+struct Case {
+    const char *name;   // 参考图片的前缀
+    const char *scene;  // 相对数据目录
+    const char *args;   // 其余的 a2 参数
+    float depthMin;
+    float depthMax;
+    // 网格按三角形的面法线着色, 参考图片插值了顶点法线, 这两个场景的
+    // 图像和法线图只能查出明显的错误: 两者的 RMSE 上限, 0 表示用通常的阈值
+    double flatShadedRmse;
+};
+
+const Case kCases[] = {
+    {"a01", "scene01_plane.txt", "", 8, 18, 0},
+    {"a02", "scene02_cube.txt", "", 8, 18, 0},
+    {"a03", "scene03_sphere.txt", "", 8, 18, 0},
+    {"a04", "scene04_axes.txt", "", 8, 18, 0},
+    {"a05", "scene05_bunny_200.txt", "", 0.8f, 1.0f, 0.07},
+    {"a06", "scene06_bunny_1k.txt", "-bounces 4", 8, 18, 0.17},
+    {"a07", "scene07_arch.txt", "-bounces 4 -shadows", 8, 18, 0},
+};
+
+// 与默认渲染 (BVH, 逐条光线) 对比的其他渲染方式
+struct Variant {
+    const char *suffix;  // 输出文件名的后缀
+    const char *args;
+};
+
+const Variant kVariants[] = {
+    {"_octree", "-accel octree"},
+    {"_packets", "-packets"},
+    {"_wavefront", "-wavefront"},
+};
+
+struct Options {
+    std::string a2 = "a2";
+    std::string dataDir = "data";
+    std::string refDir = "sample_out";
+    std::string flatRefDir = "test/flat_shaded";
+    std::string outDir = ".";
+    std::string only;  // 只跑该名字的场景
+    int size = 800;
+    int threads = 0;
+    Limits limits = {0.01, 40, 0.5};
+};
+
+void usage() {
+    std::cerr << "Usage: a2_image_test [options]\n"
+              << "\n"
+              << "Options:\n"
+              << "\t--a2 <path>          a2 executable (default: a2)\n"
+              << "\t--data <dir>         scene directory (default: data)\n"
+              << "\t--ref <dir>          reference images (default: sample_out)\n"
+              << "\t--flat_ref <dir>     flat-shaded mesh renders (default: test/flat_shaded)\n"
+              << "\t--out <dir>          where renders and diff images go (default: .)\n"
+              << "\t--only <name>        run a single case, e.g. a05\n"
+              << "\t--size <pixels>      render size of the references (default: 800)\n"
+              << "\t--threads <n>        threads for a2 and the comparison (default: all)\n"
+              << "\t--max_rmse <value>   largest RMSE that passes (default: 0.01)\n"
+              << "\t--min_psnr <dB>      smallest PSNR that passes (default: 40)\n"
+              << "\t--max_error <value>  largest channel error that passes (default: 0.5)\n";
+}
+
+bool parseOptions(int argc, char *argv[], Options &opt) {
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--a2" && hasValue) {
+            opt.a2 = argv[++i];
+        } else if (arg == "--data" && hasValue) {
+            opt.dataDir = argv[++i];
+        } else if (arg == "--ref" && hasValue) {
+            opt.refDir = argv[++i];
+        } else if (arg == "--flat_ref" && hasValue) {
+            opt.flatRefDir = argv[++i];
+        } else if (arg == "--out" && hasValue) {
+            opt.outDir = argv[++i];
+        } else if (arg == "--only" && hasValue) {
+            opt.only = argv[++i];
+        } else if (arg == "--size" && hasValue) {
+            opt.size = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--threads" && hasValue) {
+            opt.threads = std::max(0, atoi(argv[++i]));
+        } else if (arg == "--max_rmse" && hasValue) {
+            opt.limits.maxRmse = atof(argv[++i]);
+        } else if (arg == "--min_psnr" && hasValue) {
+            opt.limits.minPsnr = atof(argv[++i]);
+        } else if (arg == "--max_error" && hasValue) {
+            opt.limits.maxError = atof(argv[++i]);
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string quote(const std::string &s) {
+    return "\"" + s + "\"";
+}
+
+std::string joinPath(const std::string &dir, const std::string &file) {
+    if (dir.empty() || dir[dir.size() - 1] == '/' || dir[dir.size() - 1] == '\\')
+        return dir + file;
+    return dir + "/" + file;
+}
+
+bool fileExists(const std::string &path) {
+    std::ifstream in(path.c_str());
+    return in.is_open();
+}
+
+// Compares out/<file> with refDir/<refFile>, writes the difference next to
+// the render and prints one line; returns false if it fails
+bool compareImage(const Options &opt, ThreadPool &pool, const std::string &file,
+                  const std::string &refDir, const std::string &refFile, const Limits &limits) {
+    const std::string rendered = joinPath(opt.outDir, file);
+    const std::string reference = joinPath(refDir, refFile);
+    // Image::loadPNG 只用 assert 检查, 先确认文件存在
+    if (!fileExists(rendered) || !fileExists(reference)) {
+        printf("%-8s FAIL  missing %s\n", file.c_str(),
+               fileExists(rendered) ? reference.c_str() : rendered.c_str());
+        return false;
+    }
+    Image a = Image::loadPNG(rendered);
+    Image b = Image::loadPNG(reference);
+    if (a.getWidth() != b.getWidth() || a.getHeight() != b.getHeight()) {
+        printf("%-8s FAIL  %dx%d, reference is %dx%d\n", file.c_str(), a.getWidth(),
+               a.getHeight(), b.getWidth(), b.getHeight());
+        return false;
+    }
+
+    Image diff;
+    ImageError error = Image::compare(a, b, &diff, &pool);
+    diff.savePNG(joinPath(opt.outDir, file.substr(0, file.size() - 4) + "_diff.png"));
+
+    const bool ok = error.rmse <= limits.maxRmse && error.psnr >= limits.minPsnr &&
+                    error.maxError <= limits.maxError;
+    printf("%-8s %s  rmse %.5f (<= %g)  psnr %6.2f dB (>= %g)  max %.4f (<= %g)\n",
+           file.c_str(), ok ? "ok  " : "FAIL", error.rmse, limits.maxRmse, error.psnr,
+           limits.minPsnr, error.maxError, limits.maxError);
+    return ok;
+}
+
+// Renders the case as out/<name><suffix>.png, n.png and d.png with the
+// extra a2 arguments; returns false if a2 fails
+bool render(const Options &opt, const Case &c, const std::string &suffix, const char *args) {
+    const std::string name = c.name + suffix;
+    std::ostringstream cmd;
+    cmd << quote(opt.a2) << " -size " << opt.size << " " << opt.size << " -input "
+        << quote(joinPath(opt.dataDir, c.scene)) << " " << c.args << " " << args << " -output "
+        << quote(joinPath(opt.outDir, name + ".png")) << " -normals "
+        << quote(joinPath(opt.outDir, name + "n.png")) << " -depth " << c.depthMin << " "
+        << c.depthMax << " " << quote(joinPath(opt.outDir, name + "d.png"));
+    if (opt.threads > 0)
+        cmd << " -threads " << opt.threads;
+    std::cout << cmd.str() << std::endl;
+    fflush(stdout);
+    if (std::system(cmd.str().c_str()) != 0) {
+        printf("%-8s FAIL  a2 did not finish\n", name.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool runCase(const Options &opt, ThreadPool &pool, const Case &c) {
+    const std::string name = c.name;
+    if (!render(opt, c, "", ""))
+        return false;
+
+    Limits shaded = opt.limits;
+    if (c.flatShadedRmse > 0)
+        shaded = Limits{c.flatShadedRmse, 0, 1};
+    bool ok = compareImage(opt, pool, name + ".png", opt.refDir, name + ".png", shaded);
+    ok &= compareImage(opt, pool, name + "n.png", opt.refDir, name + "n.png", shaded);
+    ok &= compareImage(opt, pool, name + "d.png", opt.refDir, name + "d.png", opt.limits);
+    if (c.flatShadedRmse == 0)
+        return ok;
+
+    // 参考图片只能宽松地检查网格场景, 因此再按通常的阈值与面法线着色的
+    // 渲染结果以及其他渲染方式比较
+    ok &= compareImage(opt, pool, name + ".png", opt.flatRefDir, name + ".png", opt.limits);
+    ok &= compareImage(opt, pool, name + "n.png", opt.flatRefDir, name + "n.png", opt.limits);
+    for (const Variant &v : kVariants) {
+        if (!render(opt, c, v.suffix, v.args)) {
+            ok = false;
+            continue;
+        }
+        for (const char *map : {".png", "n.png", "d.png"}) {
+            ok &= compareImage(opt, pool, name + v.suffix + map, opt.outDir, name + map,
+                               opt.limits);
+        }
+    }
+    return ok;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+    Options opt;
+    if (!parseOptions(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+
+    ThreadPool pool(opt.threads);
+    int failed = 0, run = 0;
+    for (const Case &c : kCases) {
+        if (!opt.only.empty() && opt.only != c.name)
+            continue;
+        run++;
+        failed += !runCase(opt, pool, c);
+    }
+    if (!run) {
+        std::cerr << "No case named " << opt.only << std::endl;
+        return 2;
+    }
+    printf("%d of %d scenes passed\n", run - failed, run);
+    return failed ? 1 : 0;
+}
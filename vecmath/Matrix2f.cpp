@@ -39,30 +39,6 @@ Matrix2f::Matrix2f( const Vector2f& v0, const Vector2f& v1, bool setColumns )
 	}
 }
 
-Matrix2f::Matrix2f( const Matrix2f& rm )
-{
-	memcpy( m_elements, rm.m_elements, sizeof(m_elements));
-}
-
-Matrix2f& Matrix2f::operator = ( const Matrix2f& rm )
-{
-	if( this != &rm )
-	{
-		memcpy( m_elements, rm.m_elements, sizeof(m_elements)   );
-	}
-	return *this;
-}
-
-const float& Matrix2f::operator () ( int i, int j ) const
-{
-	return m_elements[ j * 2 + i ];
-}
-
-float& Matrix2f::operator () ( int i, int j )
-{
-	return m_elements[ j * 2 + i ];
-}
-
 Vector2f Matrix2f::getRow( int i ) const
 {
 	return Vector2f
@@ -234,35 +210,3 @@ Matrix2f operator * ( const Matrix2f& m, float f )
 	return f * m;
 }
 
-Vector2f operator * ( const Matrix2f& m, const Vector2f& v )
-{
-	Vector2f output( 0, 0 );
-
-	for( int i = 0; i < 2; ++i )
-	{
-		for( int j = 0; j < 2; ++j )
-		{
-			output[ i ] += m( i, j ) * v[ j ];
-		}
-	}
-
-	return output;
-}
-
-Matrix2f operator * ( const Matrix2f& x, const Matrix2f& y )
-{
-	Matrix2f product; // zeroes
-
-	for( int i = 0; i < 2; ++i )
-	{
-		for( int j = 0; j < 2; ++j )
-		{
-			for( int k = 0; k < 2; ++k )
-			{
-				product( i, k ) += x( i, j ) * y( j, k );
-			}
-		}
-	}
-
-	return product;
-}
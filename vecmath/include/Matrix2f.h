@@ -3,7 +3,8 @@
 
 #include <cstdio>
 
-class Vector2f;
+#include "Vector2f.h"
+
 
 // 2x2 Matrix, stored in column major order (OpenGL style)
 class Matrix2f
@@ -19,8 +20,7 @@ public:
 	// otherwise, sets the rows
 	Matrix2f( const Vector2f& v0, const Vector2f& v1, bool setColumns = true );
 
-	Matrix2f( const Matrix2f& rm ); // copy constructor
-	Matrix2f& operator = ( const Matrix2f& rm ); // assignment operator
+	// copy constructor and assignment operator are the implicit ones
 	// no destructor necessary
 
 	const float& operator () ( int i, int j ) const;
@@ -66,4 +66,51 @@ Vector2f operator * ( const Matrix2f& m, const Vector2f& v );
 // Matrix-Matrix multiplication
 Matrix2f operator * ( const Matrix2f& x, const Matrix2f& y );
 
+//////////////////////////////////////////////////////////////////////////
+// Inline implementation
+//////////////////////////////////////////////////////////////////////////
+
+inline const float& Matrix2f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 2 + i ];
+}
+
+inline float& Matrix2f::operator () ( int i, int j )
+{
+	return m_elements[ j * 2 + i ];
+}
+
+inline Vector2f operator * ( const Matrix2f& m, const Vector2f& v )
+{
+	Vector2f output( 0, 0 );
+
+	for( int i = 0; i < 2; ++i )
+	{
+		for( int j = 0; j < 2; ++j )
+		{
+			output[ i ] += m( i, j ) * v[ j ];
+		}
+	}
+
+	return output;
+}
+
+inline Matrix2f operator * ( const Matrix2f& x, const Matrix2f& y )
+{
+	Matrix2f product; // zeroes
+
+	for( int i = 0; i < 2; ++i )
+	{
+		for( int j = 0; j < 2; ++j )
+		{
+			for( int k = 0; k < 2; ++k )
+			{
+				product( i, k ) += x( i, j ) * y( j, k );
+			}
+		}
+	}
+
+	return product;
+}
+
 #endif // MATRIX2F_H
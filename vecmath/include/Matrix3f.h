@@ -3,9 +3,10 @@
 
 #include <cstdio>
 
+#include "Vector3f.h"
+
 class Matrix2f;
 class Quat4f;
-class Vector3f;
 
 // 3x3 Matrix, stored in column major order (OpenGL style)
 class Matrix3f
@@ -22,8 +23,7 @@ public:
 	// otherwise, sets the rows
 	Matrix3f( const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, bool setColumns = true );
 
-	Matrix3f( const Matrix3f& rm ); // copy constructor
-	Matrix3f& operator = ( const Matrix3f& rm ); // assignment operator
+	// copy constructor and assignment operator are the implicit ones
 	// no destructor necessary
 
 	const float& operator () ( int i, int j ) const;
@@ -88,5 +88,51 @@ Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y );
 Matrix3f operator * (const Matrix3f& m, float f);
 Matrix3f operator * (float f, const Matrix3f& m);
 
+//////////////////////////////////////////////////////////////////////////
+// Inline implementation
+//////////////////////////////////////////////////////////////////////////
+
+inline const float& Matrix3f::operator () ( int i, int j ) const
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline float& Matrix3f::operator () ( int i, int j )
+{
+	return m_elements[ j * 3 + i ];
+}
+
+inline Vector3f operator * ( const Matrix3f& m, const Vector3f& v )
+{
+	Vector3f output( 0, 0, 0 );
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			output[ i ] += m( i, j ) * v[ j ];
+		}
+	}
+
+	return output;
+}
+
+inline Matrix3f operator * ( const Matrix3f& x, const Matrix3f& y )
+{
+	Matrix3f product; // zeroes
+
+	for( int i = 0; i < 3; ++i )
+	{
+		for( int j = 0; j < 3; ++j )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				product( i, k ) += x( i, j ) * y( j, k );
+			}
+		}
+	}
+
+	return product;
+}
 
 #endif // MATRIX3F_H
@@ -3,11 +3,12 @@
 
 #include <cstdio>
 
+#include "Vector4f.h"
+
 class Matrix2f;
 class Matrix3f;
 class Quat4f;
 class Vector3f;
-class Vector4f;
 
 // 4x4 Matrix, stored in column major order (OpenGL style)
 class Matrix4f
@@ -24,8 +25,7 @@ public:
     // otherwise, sets the rows
     Matrix4f(const Vector4f& v0, const Vector4f& v1, const Vector4f& v2, const Vector4f& v3, bool setColumns = true);
 
-    Matrix4f(const Matrix4f& rm); // copy constructor
-    Matrix4f& operator = (const Matrix4f& rm); // assignment operator
+    // copy constructor and assignment operator are the implicit ones
     Matrix4f& operator/=(float d);
     // no destructor necessary
 
@@ -109,5 +109,51 @@ Matrix4f operator * (const Matrix4f& x, const Matrix4f& y);
 Matrix4f operator * (const Matrix4f& m, float f);
 Matrix4f operator * (float f, const Matrix4f& m);
 
+//////////////////////////////////////////////////////////////////////////
+// Inline implementation
+//////////////////////////////////////////////////////////////////////////
+
+inline const float& Matrix4f::operator () ( int i, int j ) const
+{
+    return m_elements[ j * 4 + i ];
+}
+
+inline float& Matrix4f::operator () ( int i, int j )
+{
+    return m_elements[ j * 4 + i ];
+}
+
+inline Vector4f operator * ( const Matrix4f& m, const Vector4f& v )
+{
+    Vector4f output( 0, 0, 0, 0 );
+
+    for( int i = 0; i < 4; ++i )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            output[ i ] += m( i, j ) * v[ j ];
+        }
+    }
+
+    return output;
+}
+
+inline Matrix4f operator * ( const Matrix4f& x, const Matrix4f& y )
+{
+    Matrix4f product; // zeroes
+
+    for( int i = 0; i < 4; ++i )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            for( int k = 0; k < 4; ++k )
+            {
+                product( i, k ) += x( i, j ) * y( j, k );
+            }
+        }
+    }
+
+    return product;
+}
 
 #endif // MATRIX4F_H
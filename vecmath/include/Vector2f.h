@@ -5,65 +5,64 @@
 
 class Vector3f;
 
+// Everything but print() and the constants is defined inline below, so
+// the compiler sees through vector arithmetic in hot loops. The class is
+// trivially copyable and laid out as float[2].
 class Vector2f
 {
 public:
-    
+
     static const Vector2f ZERO;
 	static const Vector2f UP;
 	static const Vector2f RIGHT;
 
-    explicit Vector2f( float f = 0.f );
-    Vector2f( float x, float y );
-
-	// copy constructors
-    Vector2f( const Vector2f& rv );
+    constexpr explicit Vector2f( float f = 0.f );
+    constexpr Vector2f( float x, float y );
 
-	// assignment operators
-	Vector2f& operator = ( const Vector2f& rv );
+	// copy constructors and assignment operators are the implicit ones
 
 	// no destructor necessary
 
 	// returns the ith element
-    const float& operator [] ( int i ) const;
+    constexpr const float& operator [] ( int i ) const;
 	float& operator [] ( int i );
 
     float& x();
 	float& y();
 
-	float x() const;
-	float y() const;
+	constexpr float x() const;
+	constexpr float y() const;
 
-    Vector2f xy() const;
-	Vector2f yx() const;
-	Vector2f xx() const;
-	Vector2f yy() const;
+    constexpr Vector2f xy() const;
+	constexpr Vector2f yx() const;
+	constexpr Vector2f xx() const;
+	constexpr Vector2f yy() const;
 
 	// returns ( -y, x )
-    Vector2f normal() const;
+    constexpr Vector2f normal() const;
 
     float abs() const;
-    float absSquared() const;
+    constexpr float absSquared() const;
     void normalize();
     Vector2f normalized() const;
 
     void negate();
 
 	// ---- Utility ----
-    operator const float* () const; // automatic type conversion for OpenGL 
-    operator float* (); // automatic type conversion for OpenGL 
+    operator const float* () const; // automatic type conversion for OpenGL
+    operator float* (); // automatic type conversion for OpenGL
 	void print() const;
 
 	Vector2f& operator += ( const Vector2f& v );
 	Vector2f& operator -= ( const Vector2f& v );
 	Vector2f& operator *= ( float f );
 
-    static float dot( const Vector2f& v0, const Vector2f& v1 );
+    static constexpr float dot( const Vector2f& v0, const Vector2f& v1 );
 
 	static Vector3f cross( const Vector2f& v0, const Vector2f& v1 );
 
 	// returns v0 * ( 1 - alpha ) * v1 * alpha
-	static Vector2f lerp( const Vector2f& v0, const Vector2f& v1, float alpha );
+	static constexpr Vector2f lerp( const Vector2f& v0, const Vector2f& v1, float alpha );
 
 private:
 
@@ -72,20 +71,209 @@ private:
 };
 
 // component-wise operators
-Vector2f operator + ( const Vector2f& v0, const Vector2f& v1 );
-Vector2f operator - ( const Vector2f& v0, const Vector2f& v1 );
-Vector2f operator * ( const Vector2f& v0, const Vector2f& v1 );
-Vector2f operator / ( const Vector2f& v0, const Vector2f& v1 );
+constexpr Vector2f operator + ( const Vector2f& v0, const Vector2f& v1 );
+constexpr Vector2f operator - ( const Vector2f& v0, const Vector2f& v1 );
+constexpr Vector2f operator * ( const Vector2f& v0, const Vector2f& v1 );
+constexpr Vector2f operator / ( const Vector2f& v0, const Vector2f& v1 );
 
 // unary negation
-Vector2f operator - ( const Vector2f& v );
+constexpr Vector2f operator - ( const Vector2f& v );
 
 // multiply and divide by scalar
-Vector2f operator * ( float f, const Vector2f& v );
-Vector2f operator * ( const Vector2f& v, float f );
-Vector2f operator / ( const Vector2f& v, float f );
+constexpr Vector2f operator * ( float f, const Vector2f& v );
+constexpr Vector2f operator * ( const Vector2f& v, float f );
+constexpr Vector2f operator / ( const Vector2f& v, float f );
+
+constexpr bool operator == ( const Vector2f& v0, const Vector2f& v1 );
+constexpr bool operator != ( const Vector2f& v0, const Vector2f& v1 );
+
+//////////////////////////////////////////////////////////////////////////
+// Inline implementation
+//////////////////////////////////////////////////////////////////////////
+
+constexpr Vector2f::Vector2f( float f ) : m_elements{ f, f }
+{
+}
+
+constexpr Vector2f::Vector2f( float x, float y ) : m_elements{ x, y }
+{
+}
+
+constexpr const float& Vector2f::operator [] ( int i ) const
+{
+    return m_elements[i];
+}
 
-bool operator == ( const Vector2f& v0, const Vector2f& v1 );
-bool operator != ( const Vector2f& v0, const Vector2f& v1 );
+inline float& Vector2f::operator [] ( int i )
+{
+    return m_elements[i];
+}
+
+inline float& Vector2f::x()
+{
+    return m_elements[0];
+}
+
+inline float& Vector2f::y()
+{
+    return m_elements[1];
+}
+
+constexpr float Vector2f::x() const
+{
+    return m_elements[0];
+}
+
+constexpr float Vector2f::y() const
+{
+    return m_elements[1];
+}
+
+constexpr Vector2f Vector2f::xy() const
+{
+    return *this;
+}
+
+constexpr Vector2f Vector2f::yx() const
+{
+    return Vector2f( m_elements[1], m_elements[0] );
+}
+
+constexpr Vector2f Vector2f::xx() const
+{
+    return Vector2f( m_elements[0], m_elements[0] );
+}
+
+constexpr Vector2f Vector2f::yy() const
+{
+    return Vector2f( m_elements[1], m_elements[1] );
+}
+
+constexpr Vector2f Vector2f::normal() const
+{
+    return Vector2f( -m_elements[1], m_elements[0] );
+}
+
+inline float Vector2f::abs() const
+{
+    return sqrt(absSquared());
+}
+
+constexpr float Vector2f::absSquared() const
+{
+    return m_elements[0] * m_elements[0] + m_elements[1] * m_elements[1];
+}
+
+inline void Vector2f::normalize()
+{
+    float norm = abs();
+    m_elements[0] /= norm;
+    m_elements[1] /= norm;
+}
+
+inline Vector2f Vector2f::normalized() const
+{
+    float norm = abs();
+    return Vector2f( m_elements[0] / norm, m_elements[1] / norm );
+}
+
+inline void Vector2f::negate()
+{
+    m_elements[0] = -m_elements[0];
+    m_elements[1] = -m_elements[1];
+}
+
+inline Vector2f::operator const float* () const
+{
+    return m_elements;
+}
+
+inline Vector2f::operator float* ()
+{
+    return m_elements;
+}
+
+inline Vector2f& Vector2f::operator += ( const Vector2f& v )
+{
+	m_elements[ 0 ] += v.m_elements[ 0 ];
+	m_elements[ 1 ] += v.m_elements[ 1 ];
+	return *this;
+}
+
+inline Vector2f& Vector2f::operator -= ( const Vector2f& v )
+{
+	m_elements[ 0 ] -= v.m_elements[ 0 ];
+	m_elements[ 1 ] -= v.m_elements[ 1 ];
+	return *this;
+}
+
+inline Vector2f& Vector2f::operator *= ( float f )
+{
+	m_elements[ 0 ] *= f;
+	m_elements[ 1 ] *= f;
+	return *this;
+}
+
+// static
+constexpr float Vector2f::dot( const Vector2f& v0, const Vector2f& v1 )
+{
+    return v0[0] * v1[0] + v0[1] * v1[1];
+}
+
+// static
+constexpr Vector2f Vector2f::lerp( const Vector2f& v0, const Vector2f& v1, float alpha )
+{
+	return alpha * ( v1 - v0 ) + v0;
+}
+
+constexpr Vector2f operator + ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() + v1.x(), v0.y() + v1.y() );
+}
+
+constexpr Vector2f operator - ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() - v1.x(), v0.y() - v1.y() );
+}
+
+constexpr Vector2f operator * ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() * v1.x(), v0.y() * v1.y() );
+}
+
+constexpr Vector2f operator / ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return Vector2f( v0.x() * v1.x(), v0.y() * v1.y() );
+}
+
+constexpr Vector2f operator - ( const Vector2f& v )
+{
+    return Vector2f( -v.x(), -v.y() );
+}
+
+constexpr Vector2f operator * ( float f, const Vector2f& v )
+{
+    return Vector2f( f * v.x(), f * v.y() );
+}
+
+constexpr Vector2f operator * ( const Vector2f& v, float f )
+{
+    return Vector2f( f * v.x(), f * v.y() );
+}
+
+constexpr Vector2f operator / ( const Vector2f& v, float f )
+{
+    return Vector2f( v.x() / f, v.y() / f );
+}
+
+constexpr bool operator == ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return( v0.x() == v1.x() && v0.y() == v1.y() );
+}
+
+constexpr bool operator != ( const Vector2f& v0, const Vector2f& v1 )
+{
+    return !( v0 == v1 );
+}
 
 #endif // VECTOR_2F_H